@@ -1,15 +1,21 @@
 #include <QFile>
 #include <QTextStream>
 #include <QApplication>
+#include <QStandardPaths>
 
+#include "PixelTrace.h"
 #include "mainwindow.h"
 
 int main(int argc, char *argv[])
 {
+    PB_TRACE_THREAD("main");
+    // ended by the first frame of the game widget
+    PB_TRACE_BEGIN("startup", 0);
     QApplication a(argc, argv);
     QFile file(":/RES/style");
     if(file.open(QFile::ReadOnly))
     {
+        PB_TRACE_SCOPE("styleSheet");
         QTextStream qts(&file);
         QString styles = qts.readAll();
         a.setStyleSheet(styles);
@@ -17,5 +23,11 @@ int main(int argc, char *argv[])
 
     MainWindow mainWindow;
     mainWindow.show();
-    return a.exec();
+    int result = a.exec();
+#ifdef PB_TRACE
+    QString path = qEnvironmentVariable("PB_TRACE_FILE", QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/trace.json");
+    if(!writeTrace(path.toLocal8Bit().constData()))
+        qWarning("trace is not written to %s", qPrintable(path));
+#endif
+    return result;
 }
@@ -1,6 +1,11 @@
+#include <QDir>
+#include <QFileDialog>
 #include <QMessageBox>
 #include <QRandomGenerator>
+#include <QStandardPaths>
 
+#include "PixelResourceLoader.h"
+#include "PixelTrace.h"
 #include "mainwindow.h"
 #include "ui_mainwindow.h"
 
@@ -56,20 +61,21 @@ void resetIDSettings(QSettings *settings)
 }
 MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent), ui(new Ui::MainWindow), currentAccount {}, anyUsers {}, network(nullptr), onlineSetup(0)
 {
+    PB_TRACE_SCOPE("MainWindow::MainWindow");
     settings = new QSettings("badcast", "Pixel Blast", this);
+    // a theme made by pixelblast_bundle replaces the sprites of the library, edits of it are loaded while playing
+    ResourceLoader::instance()->setPack(settings->value("RESOURCE_PACK").toString());
 
     pxbModule = new PixelBlast(this);
 
     ui->setupUi(this);
     ui->overlay->addWidget(pxbModule);
 
-    timer = new QTimer(this);
-    timer->setSingleShot(false);
-    timer->setInterval(500);
-    QObject::connect(timer, &QTimer::timeout, this, &MainWindow::updateWindow);
-    timer->start();
-
+    // the texts change with the game, nothing is polled
+    QObject::connect(pxbModule, &PixelBlast::scoresChanged, this, &MainWindow::updateWindow);
     QObject::connect(pxbModule, &PixelBlast::endOfGame, this, &MainWindow::endOfGame);
+    // the game starts below while the images are decoded, loadingText covers it until they are done
+    QObject::connect(pxbModule, &PixelBlast::resourcesReady, this, &MainWindow::resourcesReady);
 
     writeLog("Инициализация...");
     auto result = readFromSettings(settings);
@@ -84,11 +90,44 @@ MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent), ui(new Ui::MainWi
         resetIDSettings(settings);
         ui->textUserName->setText(generateNick());
     }
-    showLoadPage(false);
+    ui->boardSizeBox->blockSignals(true);
+    for(int size : BoardSizes)
+        ui->boardSizeBox->addItem(QString("%1x%1").arg(size), size);
+    ui->boardSizeBox->setCurrentIndex(qMax(0, ui->boardSizeBox->findData(settings->value("BOARD", DefaultBoardWidth).toInt())));
+    ui->boardSizeBox->blockSignals(false);
+    pxbModule->setBoardSize(ui->boardSizeBox->currentData().toInt());
+    ui->checkedRotation->blockSignals(true);
+    ui->checkedRotation->setChecked(settings->value("ROTATION", false).toBool());
+    ui->checkedRotation->blockSignals(false);
+    pxbModule->setRotation(ui->checkedRotation->isChecked());
+    // slow machines draw the frames on a worker thread, the GUI thread only shows them
+    pxbModule->setThreadedRendering(settings->value("RENDER_THREAD", false).toBool());
+
+    // every game is recorded, a replay reproduces a bug report or a high score
+    replayDir = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/replays";
+    if(QDir().mkpath(replayDir))
+        pxbModule->setReplayDirectory(replayDir);
+    // F3 shows the frame profiler, F4 writes its frames next to the replays
+    pxbModule->setProfileDirectory(QStandardPaths::writableLocation(QStandardPaths::AppDataLocation));
+
+    showLoadPage(!pxbModule->isLoaded());
     setOnlineMode(false);
     writeLog("Игра запущена.");
     setWindowTitle("Pixel Blast Game");
 
+    // mapped after the games started above, the game of the last session goes on
+    pxbModule->setAutosaveFile(QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/autosave.pbsv");
+    if(pxbModule->resumeGame())
+    {
+        ui->boardSizeBox->blockSignals(true);
+        ui->boardSizeBox->setCurrentIndex(qMax(0, ui->boardSizeBox->findData(pxbModule->boardSize())));
+        ui->boardSizeBox->blockSignals(false);
+        ui->checkedRotation->blockSignals(true);
+        ui->checkedRotation->setChecked(pxbModule->rotation());
+        ui->checkedRotation->blockSignals(false);
+        writeLog("Игра восстановлена. Ctrl+Z отмена хода, Ctrl+Y повтор");
+    }
+
     updateWindow();
 }
 
@@ -153,6 +192,12 @@ void MainWindow::showLoadPage(bool value)
     pxbModule->setVisible(!value);
 }
 
+void MainWindow::resourcesReady()
+{
+    showLoadPage(false);
+    pxbModule->setFocus();
+}
+
 void MainWindow::writeLog(QString log)
 {
     qDebug() << log;
@@ -218,6 +263,7 @@ void MainWindow::receiveStats(const QList<PixelStats> &stats, NetworkResultFlags
                 break;
             }
         }
+        updateWindow();
     }
     else
     {
@@ -315,3 +361,34 @@ void MainWindow::on_resetIDBut_clicked()
         ui->textUserName->setText(generateNick());
     }
 }
+
+void MainWindow::on_boardSizeBox_currentIndexChanged(int index)
+{
+    int size = ui->boardSizeBox->itemData(index).toInt();
+    settings->setValue("BOARD", size);
+    pxbModule->setBoardSize(size);
+    pxbModule->startGame();
+    writeLog(QString("Размер поля: %1x%1").arg(size));
+}
+
+void MainWindow::on_replayBut_clicked()
+{
+    QString path = QFileDialog::getOpenFileName(this, "Повтор игры", replayDir, "Pixel Blast Replay (*.pbrp)");
+    if(path.isEmpty())
+        return;
+    if(!pxbModule->playReplay(path))
+    {
+        QMessageBox::warning(this, "Повтор игры", "Файл повтора повреждён или не поддерживается.");
+        return;
+    }
+    writeLog("Повтор: ← → шаг, Esc новая игра");
+}
+
+void MainWindow::on_checkedRotation_checkStateChanged(const Qt::CheckState &arg1)
+{
+    bool value = arg1 == Qt::CheckState::Checked;
+    settings->setValue("ROTATION", value);
+    pxbModule->setRotation(value);
+    pxbModule->startGame();
+    writeLog(value ? "Поворот фигур: R или колесо мыши" : "Поворот фигур выключен");
+}
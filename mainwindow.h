@@ -5,7 +5,6 @@
 
 #include <QMainWindow>
 #include <QSettings>
-#include <QTimer>
 
 #include "PixelBegin.h"
 #include "PixelBlastGame.h"
@@ -39,6 +38,8 @@ private:
 private slots:
     void updateWindow();
 
+    void resourcesReady();
+
     void endOfGame();
 
     void receiveCurrent(const PixelStats &stat, NetworkResultFlags ok);
@@ -53,6 +54,12 @@ private slots:
 
     void on_resetIDBut_clicked();
 
+    void on_boardSizeBox_currentIndexChanged(int index);
+
+    void on_replayBut_clicked();
+
+    void on_checkedRotation_checkStateChanged(const Qt::CheckState &arg1);
+
 private:
     int onlineSetup;
     QSettings *settings;
@@ -62,7 +69,7 @@ private:
     std::shared_ptr<QList<PixelStats>> anyUsers;
     PixelNetwork *network;
 
-    QTimer *timer;
+    QString replayDir;
 };
 
 #endif // MAINWINDOW_H
@@ -1,219 +1,400 @@
+#include <algorithm>
 #include <cstdint>
 #include <cstring>
 #include <utility>
 #include <memory>
 #include <stdexcept>
 #include <functional>
+#include <random>
 
 #include <QFile>
-#include <QRandomGenerator>
 #include <QPainter>
 #include <QBrush>
 #include <QPalette>
 #include <QMouseEvent>
-#include <QTextStream>
+#include <QKeyEvent>
+#include <QKeySequence>
+#include <QWheelEvent>
 #include <QMessageBox>
 #include <QCursor>
+#include <QDateTime>
+#include <QDebug>
+#include <QFontMetricsF>
+#include <QScreen>
 
+#include "PixelAllocTrace.h"
 #include "PixelBlastGame.h"
-#include "PixelBlastShapes.h"
+#include "PixelFrameComposer.h"
 #include "PixelNetwork.h"
+#include "PixelResourceLoader.h"
 #include "PixelSoundManager.h"
+#include "PixelTrace.h"
+
+// Search time of the solver, well inside of a 60 FPS frame
+constexpr std::chrono::microseconds SolverBudget(2000);
+// Game ticks between two moves of the replay playback
+constexpr int ReplayStepFrames = 30;
+// Length of a game tick, the frames of the screen may be shorter or longer
+constexpr qint64 TickNanoseconds = 1000000000 / 60;
+// Ticks played in one frame at most, a stall does not jump the animations
+constexpr int MaxFrameTicks = 4;
+
+// Sound names are built once, a frame never formats a string
+static const std::array<QString, 2> SoundPlace = {QStringLiteral("block-place0"), QStringLiteral("block-place1")};
+static const std::array<QString, 2> SoundClick = {QStringLiteral("block-click0"), QStringLiteral("block-click1")};
+static const std::array<QString, 3> SoundVoice = {QStringLiteral("voice0"), QStringLiteral("voice1"), QStringLiteral("voice2")};
+static const QString SoundHits = QStringLiteral("block-hits");
+static const QString SoundDestroy = QStringLiteral("block-destroy");
+static const QString SoundGameOver = QStringLiteral("voice-gameover");
+static const QString TextPraise = QStringLiteral("МОЛОДЕЦ!");
+static const QString TextDoomed = QStringLiteral("ТУПИК!");
+
+PixelBlast::PixelBlast(QWidget *parent) : QWidget(parent), frames(0), frameIndex(0), lastSelectedBlock(-1), mouseDownMode(true), cellScale(1.0F, 1.0F), boardRegion(0, 0, 328, 328), updateTimer(this), tickTime(0), playing(false), hintCandidate(-1), doomed(false), replayPosition(0), replaying(false), recordable(true), autosaveData(nullptr), autosaveSequence(0), destroyScaler(0), destroyCount(0), shapeCandidateIdx(-1), composer(nullptr), threaded(false), frameDirty(false), allocationMark(0), allocationMax(0)
+{
+    // the images are decoded on a thread pool, the widget is drawn and played when they are done
+    ResourceLoader *loader = ResourceLoader::instance();
+    resize(boardRegion.size().scaled(boardRegion.width() + 50, boardRegion.height() + 50, Qt::AspectRatioMode::IgnoreAspectRatio).toSize());
+
+    cellSquare = engine.boardWidth();
+    gridHover = {};
+    engine.setColorCount(loader->colorCount());
 
-constexpr int MaxCellWidth = 8;
+    // PB_PROFILE=1 starts with the profiler overlay, F3 toggles it
+    profiler.setEnabled(qEnvironmentVariableIntValue("PB_PROFILE") != 0);
+
+    // sound variants do not touch the game generator, so a seed replays the same game
+    effects.seed(std::random_device {}());
+    setMouseTracking(true);
+    setFocusPolicy(Qt::StrongFocus);
+    updateTimer.setSingleShot(false);
+    updateTimer.setTimerType(Qt::PreciseTimer);
+    clock.start();
+
+    // the static layer covers the whole widget
+    setAttribute(Qt::WA_OpaquePaintEvent);
+
+    style.font = font();
+    style.textColor = palette().color(QPalette::WindowText);
+    style.praiseFont = font();
+    style.praiseFont.setPixelSize(128);
+    style.warningFont = font();
+    style.warningFont.setPixelSize(48);
+    style.praise = TextPraise;
+    style.doomed = TextDoomed;
+    praiseBounds = QFontMetricsF(style.praiseFont).boundingRect(TextPraise);
 
-std::shared_ptr<PGlobalResources> _resource;
+    QObject::connect(&updateTimer, &QTimer::timeout, this, &PixelBlast::updateScene);
+    // queued when the loader is done already, the owner connects to resourcesReady after the constructor
+    QObject::connect(loader, &ResourceLoader::ready, this, &PixelBlast::resourcesLoaded);
+    if(loader->isReady())
+        QMetaObject::invokeMethod(this, &PixelBlast::resourcesLoaded, Qt::QueuedConnection);
+}
 
-QPixmap adjustBright(const QPixmap &pixmap, int brightness)
+void PixelBlast::resourcesLoaded()
 {
-    QImage img = pixmap.toImage();
-    QColor color;
-    int x, y;
-    for(x = 0; x < img.width(); ++x)
-    {
-        for(y = 0; y < img.height(); ++y)
-        {
-            color = std::move(img.pixelColor(x, y));
-            color.setRed(qBound(0, color.red() + brightness, 255));
-            color.setGreen(qBound(0, color.green() + brightness, 255));
-            color.setBlue(qBound(0, color.blue() + brightness, 255));
-            img.setPixelColor(x, y, color);
-        }
-    }
-    return QPixmap::fromImage(img);
+    bool first = _res == nullptr;
+    std::shared_ptr<PGlobalResources> res = ResourceLoader::instance()->resources();
+    if(res == _res)
+        return;
+    _res = std::move(res);
+
+    QBrush background(_res->background);
+    QPalette pal = palette();
+    pal.setBrush(QPalette::Window, background);
+    setPalette(pal);
+
+    QCursor cur(QPixmap::fromImage(_res->cursor), 0, 0);
+    setCursor(cur);
+
+    // the layer and the composer of a pack loaded before are drawn from its sprites
+    staticLayer = {};
+    delete composer;
+    composer = nullptr;
+    setThreadedRendering(threaded);
+    if(first)
+        emit resourcesReady();
+    invalidate(rect());
+    wakeLoop();
 }
 
-template <typename InT, typename OutT>
-constexpr inline OutT map(const InT x, const InT in_min, const InT in_max, const OutT out_min, const OutT out_max)
+bool PixelBlast::isLoaded()
 {
-    if(in_max == in_min)
-    {
-        return out_min;
-    }
-    OutT mapped_value = (x - in_min) * (out_max - out_min) / (in_max - in_min) + out_min;
-    return qMin(qMax(mapped_value, out_min), out_max);
+    return _res != nullptr;
 }
 
-inline QPixmap *getColoredPixmap(int color, int frameIndex, std::shared_ptr<PGlobalResources> &_res)
+void PixelBlast::startGame()
 {
-    BlockResource *br = &(*_res->BlockRes)[color];
-    return &(br->resources[frameIndex % br->resources.size()]);
+    resetGame();
+    playing = true;
+    wakeLoop();
 }
 
-inline void drawShapeAt(const ShapeBlock &shape, QPointF destPoint, QSizeF size, int frameIndex, QPainter &p, std::shared_ptr<PGlobalResources> &_res, QPixmap *pixmap = nullptr)
+void PixelBlast::stopGame()
 {
-    int x;
-    QRectF dest;
-    dest.setSize(size);
-    if(pixmap == nullptr)
-        pixmap = getColoredPixmap(shape.shapeColor, frameIndex, _res);
-    for(x = 0; x < shape.blocks.size(); ++x)
+    playing = false;
+    updateTimer.stop();
+}
+
+void PixelBlast::resetGame()
+{
+    if(replaying)
     {
-        dest.moveTopLeft(shape.blocks[x].adjustPoint(destPoint, dest.size()));
-        p.drawPixmap(dest, *pixmap, {});
+        // back to the settings and the seed chain of the game played before the replay
+        startReplay(engine, gameSettings);
+        engine.setSeed(mixSeed(gameSettings.seed));
     }
-};
+    replaying = false;
+    recordable = true;
+    resetView();
+    // a pack of another number of colors is played from the next game on
+    if(_res)
+        engine.setColorCount(_res->BlockRes->size());
+    engine.reset();
+    recorder.close();
+    history.clear();
+    saveGame();
+    syncCandidates();
+    updateTexts();
+    updateData();
+}
 
-void prepareResources()
+void PixelBlast::resetView()
 {
-    // Load and initialize globalResources
-    if(_resource)
-        return;
+    frames = 0;
+    frameIndex = 0;
+    shapeCandidateIdx = -1;
+    lastSelectedBlock = -1;
+    currentShape = {};
+    shapeCandidates.fill({});
+    destroyScaler = 0;
+    destroyCount = 0;
+    gridHover = {};
+    gridHint = {};
+    hintCandidate = -1;
+    doomed = false;
+}
 
-    constexpr auto _formatResourceName = ":/pixelblastgame/resourcepacks/blocks/%s";
-    constexpr auto _formatBlocks = "%s %d %s";
-    constexpr auto MaxBufLen = 128;
+void PixelBlast::setReplayDirectory(const QString &path)
+{
+    replayDirectory = path;
+}
 
-    int n;
-    char buff[MaxBufLen], buff0[64], buff1[64];
+void PixelBlast::openRecorder()
+{
+    QString path;
+    if(replayDirectory.isEmpty())
+        return;
+    path = QString("%1/%2-%3.pbrp").arg(replayDirectory, QDateTime::currentDateTime().toString("yyyyMMdd-hhmmss")).arg(engine.seed(), 16, 16, QChar('0'));
+    if(!recorder.open(QFile::encodeName(path).constData(), replayHeader(engine)))
+        qWarning() << "Replay is not recorded:" << path;
+}
 
-    BlockResource tmp;
-    QString content, bfName;
-    std::snprintf(buff, MaxBufLen, _formatResourceName, "blocks.cfg");
-    QFile file(buff);
-    if(!file.open(QFile::ReadOnly | QFile::Text))
+void PixelBlast::setAutosaveFile(const QString &path)
+{
+    Autosave save;
+    if(autosaveData != nullptr)
+        autosaveFile.unmap(autosaveData);
+    autosaveFile.close();
+    autosaveData = nullptr;
+    autosaveSequence = 0;
+    if(path.isEmpty())
+        return;
+
+    autosaveFile.setFileName(path);
+    if(!autosaveFile.open(QIODevice::ReadWrite) || (autosaveFile.size() != AutosaveSize && !autosaveFile.resize(AutosaveSize)) || (autosaveData = autosaveFile.map(0, AutosaveSize)) == nullptr)
     {
-        throw std::runtime_error("Resource is not access");
+        qWarning() << "Game is not saved:" << path;
+        autosaveFile.close();
         return;
     }
+    // the next save goes to the older slot
+    if(readAutosave(autosaveData, AutosaveSize, save))
+        autosaveSequence = save.sequence;
+}
 
-    _resource = std::make_shared<PGlobalResources>();
+void PixelBlast::saveGame()
+{
+    // a copy to the mapped pages, the system writes them to the disk
+    if(autosaveData != nullptr && !replaying)
+        writeAutosave(autosaveData, engine, ++autosaveSequence);
+}
 
-    QTextStream stream(&file);
-    _resource->BlockRes = std::make_shared<QList<BlockResource>>();
-    while(stream.readLineInto(&content))
-    {
-        if(sscanf((content).toLocal8Bit().data(), _formatBlocks, buff, &n, buff0) != 3)
-        {
-            _resource->BlockRes.reset();
-            return;
-        }
-        tmp.name = buff;
-        for(int i = 0; i < n; ++i)
-        {
-            snprintf(buff, MaxBufLen, _formatResourceName, buff0);
-            content = buff;
-            content.replace(QChar('#'), QString::number(i + 1));
-            QPixmap qp(content);
-            tmp.resources.append(std::move(qp));
-        }
-        _resource->BlockRes->append(std::move(tmp));
-    }
-    _resource->gameLogo = std::make_shared<QPixmap>(std::move(QPixmap(":/pixelblastgame/game-logo")));
-    _resource->uiTopHeader = std::make_shared<QPixmap>(std::move(QPixmap(":/pixelblastgame/ui-top")));
-    _resource->backgroundPix = std::make_shared<QPixmap>(std::move(QPixmap(":/pixelblastgame/background")));
-    _resource->cursorPix = std::make_shared<QPixmap>(std::move(QPixmap(":/pixelblastgame/arrow")));
-    _resource->gridBackgroundBorder = std::make_shared<QPixmap>(std::move(QPixmap(":/pixelblastgame/grid-border")));
-    _resource->gridBackground = std::make_shared<QPixmap>(std::move(QPixmap(":/pixelblastgame/grid-background")));
-    _resource->gridBackgroundBg = std::make_shared<QPixmap>(std::move(QPixmap(":/pixelblastgame/grid-background-bg")));
-    _resource->gridCell = std::make_shared<QPixmap>(std::move(adjustBright(QPixmap(":/pixelblastgame/grid-cell"), 40)));
-    _resource->gridCellBright = std::make_shared<QPixmap>(std::move(adjustBright(*_resource->gridCell, 70)));
+bool PixelBlast::resumeGame()
+{
+    Autosave save;
+    if(autosaveData == nullptr || replaying || !readAutosave(autosaveData, AutosaveSize, save))
+        return false;
+    // a save of more colors than the loaded blocks have is not resumed
+    if((_res && save.header.colorCount > _res->BlockRes->size()) || !resumeAutosave(engine, save))
+        return false;
+    // the moves before the resume are not recorded, the rest of the game would not replay
+    recordable = false;
+    recorder.close();
+    history.clear();
+    resetView();
+    syncCandidates();
+    checkDoomed();
+    updateTexts();
+    updateData();
+    return true;
+}
 
-    // Sounds
-    _resource->soundManager = std::make_shared<SoundManager>(nullptr);
-    _resource->soundManager->setPoolSize(24);
-    _resource->soundManager->registerSound("block-hits", QUrl::fromLocalFile(":/pixelblastgame/block-hits"), false);
+bool PixelBlast::undoMove()
+{
+    if(replaying || !isPlaying() || !history.undo(engine))
+        return false;
+    // the replay has no undo records, the rest of the game is not recorded
+    recordable = false;
+    recorder.close();
+    resetView();
+    syncCandidates();
+    checkDoomed();
+    updateTexts();
+    saveGame();
+    return true;
+}
 
-    _resource->soundManager->registerSound("block-click0", QUrl::fromLocalFile(":/pixelblastgame/block-click0"));
-    _resource->soundManager->registerSound("block-click1", QUrl::fromLocalFile(":/pixelblastgame/block-click1"));
-    _resource->soundManager->registerSound("block-click2", QUrl::fromLocalFile(":/pixelblastgame/block-click2"));
+bool PixelBlast::redoMove()
+{
+    if(replaying || !isPlaying() || !history.redo(engine).placed)
+        return false;
+    resetView();
+    syncCandidates();
+    checkDoomed();
+    updateTexts();
+    saveGame();
+    return true;
+}
 
-    _resource->soundManager->registerSound("block-place0", QUrl::fromLocalFile(":/pixelblastgame/block-place0"));
-    _resource->soundManager->registerSound("block-place1", QUrl::fromLocalFile(":/pixelblastgame/block-place1"));
-    _resource->soundManager->registerSound("block-place2", QUrl::fromLocalFile(":/pixelblastgame/block-place2"));
+bool PixelBlast::playReplay(const QString &path)
+{
+    Replay loaded;
+    if(!loadReplay(QFile::encodeName(path).constData(), loaded))
+        return false;
+    replay = std::move(loaded);
+    if(!replaying)
+        gameSettings = replayHeader(engine);
+    replaying = true;
+    recorder.close();
+    seekReplay(0);
+    playing = true;
+    wakeLoop();
+    return true;
+}
 
-    _resource->soundManager->registerSound("voice0", QUrl::fromLocalFile(":/pixelblastgame/voice0"));
-    _resource->soundManager->registerSound("voice1", QUrl::fromLocalFile(":/pixelblastgame/voice1"));
-    _resource->soundManager->registerSound("voice2", QUrl::fromLocalFile(":/pixelblastgame/voice2"));
-    _resource->soundManager->registerSound("voice3", QUrl::fromLocalFile(":/pixelblastgame/voice3"));
-    _resource->soundManager->registerSound("voice-gameover", QUrl::fromLocalFile(":/pixelblastgame/voice-gameover"));
+void PixelBlast::seekReplay(int position)
+{
+    if(!replaying)
+        return;
+    resetView();
+    // the next recorded move waits a whole step
+    frames = 1;
+    replayPosition = replayMoves(engine, replay, qBound(0, position, static_cast<int>(replay.moves.size())));
+    syncCandidates();
+    checkDoomed();
+    updateTexts();
+    updateData();
+}
 
-    _resource->soundManager->registerSound("block-destroy", QUrl::fromLocalFile(":/pixelblastgame/block-destroy"));
+bool PixelBlast::isReplaying()
+{
+    return replaying;
 }
 
-PixelBlast::PixelBlast(QWidget *parent) : QWidget(parent), updateTimer(this), boardRegion(0, 0, 328, 328), round(0), cellScale(1.0F, 1.0F), shapeCandidateIdx(-1), scores(0), frames(0), frameIndex(0), destroyScaler(0), mouseDownMode(true), lastSelectedBlock(-1)
+void PixelBlast::setBoardSize(int size)
 {
-    prepareResources();
-    _res = _resource;
-    if(!_res)
-    {
-        throw std::runtime_error("prepare resources is invalid init");
-    }
-    resize(boardRegion.size().scaled(boardRegion.width() + 50, boardRegion.height() + 50, Qt::AspectRatioMode::IgnoreAspectRatio).toSize());
+    engine.setBoardWidth(size);
+    resetGame();
+}
 
-    cellSquare = MaxCellWidth;
-    grid.assign(MaxCellWidth * MaxCellWidth, 0);
+int PixelBlast::boardSize()
+{
+    return engine.boardWidth();
+}
 
-    setMouseTracking(true);
-    updateTimer.setSingleShot(false);
-    updateTimer.setInterval(1000.F / 60); // 60 FPS per sec
+void PixelBlast::setRotation(bool value)
+{
+    engine.setRotation(value);
+    resetGame();
+}
 
-    QBrush background(*_res->backgroundPix);
-    QPalette pal = palette();
-    pal.setBrush(QPalette::Window, background);
-    setPalette(pal);
-    setAutoFillBackground(true);
+bool PixelBlast::rotation()
+{
+    return engine.rotation();
+}
 
-    QCursor cur(*_res->cursorPix, 0, 0);
-    setCursor(cur);
+void PixelBlast::setSeed(std::uint64_t seed)
+{
+    engine.setSeed(seed);
+}
 
-    QObject::connect(&updateTimer, &QTimer::timeout, this, &PixelBlast::updateScene);
+std::uint64_t PixelBlast::seed()
+{
+    return engine.seed();
 }
 
-void PixelBlast::startGame()
+bool PixelBlast::isPlaying()
 {
-    resetGame();
+    return playing;
+}
+
+void PixelBlast::wakeLoop()
+{
+    qreal rate;
+    QWindow *handle = window()->windowHandle();
+    if(!_res || !playing || updateTimer.isActive() || !isVisible() || (handle != nullptr && (handle->visibility() == QWindow::Minimized || handle->visibility() == QWindow::Hidden)))
+        return;
+    // a screen of another rate may show the window since the last wake
+    rate = screen() != nullptr && screen()->refreshRate() > 0 ? screen()->refreshRate() : 60;
+    updateTimer.setInterval(qMax(1, qFloor(1000 / rate)));
+    // the idle time is not played, the first frame is one tick
+    tickTime = clock.nsecsElapsed() - TickNanoseconds;
     updateTimer.start();
 }
 
-void PixelBlast::stopGame()
+bool PixelBlast::animating() const
 {
-    updateTimer.stop();
+    // a block under a still cursor stops after one cycle of its frames
+    return destroyScaler > 0 || !currentShape.empty() || frameIndex - drawn.hoverStart < drawn.hoverFrames || (replaying && replayPosition < static_cast<int>(replay.moves.size()));
 }
 
-void PixelBlast::resetGame()
+int PixelBlast::advanceTicks()
 {
-    round = 0;
-    scores = 0;
-    frames = 0;
-    frameIndex = 0;
-    shapeCandidateIdx = -1;
-    lastSelectedBlock = -1;
-    currentShape.reset();
-    destroyScaler = 0;
-    destroyBlocks.clear();
-    std::fill(std::begin(grid), std::end(grid), 0x00000);
-    std::fill(std::begin(shapeCandidates), std::end(shapeCandidates), nullptr);
+    qint64 ticks = (clock.nsecsElapsed() - tickTime) / TickNanoseconds;
+    tickTime += ticks * TickNanoseconds;
+    if(ticks > MaxFrameTicks)
+    {
+        tickTime = clock.nsecsElapsed();
+        ticks = MaxFrameTicks;
+    }
+    return static_cast<int>(ticks);
 }
 
-bool PixelBlast::isPlaying()
+void PixelBlast::windowVisibilityChanged(QWindow::Visibility visibility)
+{
+    // a minimized window keeps its widgets visible, only the window knows
+    if(visibility == QWindow::Minimized || visibility == QWindow::Hidden)
+        updateTimer.stop();
+    else
+        wakeLoop();
+}
+
+void PixelBlast::showEvent(QShowEvent */*event*/)
 {
-    return updateTimer.isActive();
+    if(window()->windowHandle() != nullptr)
+        QObject::connect(window()->windowHandle(), &QWindow::visibilityChanged, this, &PixelBlast::windowVisibilityChanged, Qt::UniqueConnection);
+    wakeLoop();
+}
+
+void PixelBlast::hideEvent(QHideEvent */*event*/)
+{
+    updateTimer.stop();
 }
 
 void PixelBlast::mousePressEvent(QMouseEvent *event)
 {
     mouseBtn = event->button() & 0x3;
+    wakeLoop();
 }
 
 void PixelBlast::mouseReleaseEvent(QMouseEvent *event)
@@ -221,169 +402,235 @@ void PixelBlast::mouseReleaseEvent(QMouseEvent *event)
     if(mouseDownMode)
         mouseDownUpped = (event->button() & 0x1) > 0;
     mouseBtn = 0;
+    wakeLoop();
 }
 
-QList<std::uint8_t> PixelBlast::createBlocks(int shape)
+void PixelBlast::mouseMoveEvent(QMouseEvent */*event*/)
 {
-    int x, y;
-    QList<std::uint8_t> blockArr {};
-    blockArr.resize(sizeof(shape) * 8);
-    for(x = 0, y = 0; x < blockArr.size(); ++x)
-    {
-        if((blockArr[x] = (shape >> x) & 0x1))
-            y = x;
-    }
-    blockArr.resize(y + 1);
-    return blockArr;
-}
-
-// TEST ALGO FOR ROTATE BY CLOCKWISE
-// QList<int> rotateClockwise(const QList<int> &blockSrc, int blockWidth = MaxCellWidth)
-// {
-//     int height, x, y, z, w, d;
-//     QList<int> rotated;
-//     rotated.resize(blockSrc.size(), 0);
-//     height = blockSrc.size() / blockWidth;
-//     for(y = 0; y < height; ++y)
-//     {
-//         for(x = 0; x < blockWidth; ++x)
-//         {
-//             z = y * blockWidth + x;
-//             w = height - 1 - y;
-//             d = x * height + w;
-//             rotated[d] = blockSrc[z];
-//         }
-//     }
-//     return rotated;
-// }
-
-void PixelBlast::assignBlocks(const QList<std::uint8_t> &blocks, ShapeBlock &assign)
+    // the frame reads the cursor itself, an idle loop only has to run again
+    wakeLoop();
+}
+
+void PixelBlast::leaveEvent(QEvent */*event*/)
 {
-    int x, y, z;
+    wakeLoop();
+}
 
-    assign.rows = 0;
-    assign.columns = 0;
-    assign.shapeColor = 0;
-    assign.rawBlocks.clear();
-    assign.blocks.clear();
-    if(blocks.empty())
+void PixelBlast::keyPressEvent(QKeyEvent *event)
+{
+    wakeLoop();
+    if(event->key() == Qt::Key_F3)
+    {
+        profiler.setEnabled(!profiler.enabled());
+        update();
+        return;
+    }
+    if(event->key() == Qt::Key_F4 && profiler.enabled())
     {
+        exportProfile();
         return;
     }
-    for(z = 0; z < blocks.size(); ++z)
+    if(replaying)
     {
-        if(blocks[z])
+        switch(event->key())
         {
-            // get point from matrix
-            x = z % cellSquare;
-            y = z / cellSquare;
-
-            // calcluate counts
-            assign.columns = qMax(1, qMax(assign.columns, x + 1));
-            assign.rows = qMax(1, qMax(assign.rows, y + 1));
-            assign.blocks.emplaceBack(x, y);
+            case Qt::Key_Left:
+                seekReplay(replayPosition - 1);
+                return;
+            case Qt::Key_Right:
+                seekReplay(replayPosition + 1);
+                return;
+            case Qt::Key_Escape:
+                startGame();
+                return;
         }
     }
-    x = (_res->BlockRes == nullptr) ? 0 : _res->BlockRes->size();
-    assign.rawBlocks = blocks;
-    assign.shapeColor = QRandomGenerator::global()->bounded(0, x);
+    else if(event->key() == Qt::Key_H && isPlaying())
+    {
+        showHint();
+        return;
+    }
+    else if(event->key() == Qt::Key_R && isPlaying())
+    {
+        rotateHeld(1);
+        return;
+    }
+    else if(event->matches(QKeySequence::Undo))
+    {
+        undoMove();
+        return;
+    }
+    else if(event->matches(QKeySequence::Redo) || (event->key() == Qt::Key_Y && event->modifiers() == Qt::ControlModifier))
+    {
+        redoMove();
+        return;
+    }
+    QWidget::keyPressEvent(event);
+}
+
+void PixelBlast::wheelEvent(QWheelEvent *event)
+{
+    if(replaying || currentShape.empty() || event->angleDelta().y() == 0)
+    {
+        QWidget::wheelEvent(event);
+        return;
+    }
+    rotateHeld(event->angleDelta().y() < 0 ? 1 : -1);
+    wakeLoop();
+}
+
+void PixelBlast::rotateHeld(int turns)
+{
+    int count;
+    const GameState &state = engine.state();
+    if(replaying || !state.rotation || currentShape.empty() || shapeCandidateIdx == -1)
+        return;
+    // the orientations are precomputed in the catalog, a turn only copies the cells of another entry
+    const Candidate &candidate = state.candidates[shapeCandidateIdx];
+    count = GameEngine::orientationCount(candidate.shape, state.rotation);
+    assignBlocks(candidate, currentShape, (currentShape.rotation + turns % count + count) % count);
+    gridHover = {};
+}
+
+void PixelBlast::showHint()
+{
+    SolverResult result = solver.solve(engine.state(), SolverBudget);
+    gridHint = {};
+    hintCandidate = -1;
+    doomed = result.doomed;
+    // the warning may change as well
+    invalidate(rect());
+    if(result.count == 0)
+        return;
+    hintCandidate = result.moves[0].candidate;
+    gridHint = GameEngine::placementMask(rotateShape(engine.state().candidates[hintCandidate].shape, result.moves[0].rotation), result.moves[0].cell, engine.state().width);
+}
+
+void PixelBlast::checkDoomed()
+{
+    doomed = !engine.isOver() && solver.solve(engine.state(), SolverBudget).doomed;
+}
+
+void PixelBlast::assignBlocks(const Candidate &candidate, ShapeBlock &assign, int rotation)
+{
+    int x, z;
+    const ShapeInfo &info = getShape(rotateShape(candidate.shape, rotation));
+
+    assign.shape = rotateShape(candidate.shape, rotation);
+    assign.rotation = rotation;
+    assign.shapeColor = candidate.color;
+    assign.rows = info.rows;
+    assign.columns = info.columns;
+    assign.count = info.cellCount;
+    for(x = 0; x < info.cellCount; ++x)
+    {
+        // get point from matrix
+        z = info.cells[x];
+        assign.blocks[x] = BlockObject(z % BoardStride, z / BoardStride);
+    }
 }
 
 void PixelBlast::resizeEvent(QResizeEvent *event)
 {
+    staticLayer = {};
+    if(_res)
+        _res->atlas->clear();
     updateData();
+    invalidate(rect());
 }
 
-bool PixelBlast::canTrigger(const QList<std::uint8_t> &blocks, QList<std::uint8_t> &grids, bool placeTo)
+void PixelBlast::syncCandidates()
 {
-    int x, y, z, w, d;
-    bool fits;
-    int width = qRound(std::sqrt(grids.size()));
-    for(x = 0; x < width; ++x)
+    int x;
+    const GameState &state = engine.state();
+    for(x = 0; x < shapeCandidates.size(); ++x)
     {
-        for(y = 0; y < width; ++y)
+        if(state.candidates[x].shape == -1)
         {
-            fits = true;
-            for(z = 0; z < blocks.size(); ++z)
-            {
-                if(blocks[z] == 0)
-                    continue;
-                w = x + z % width;
-                d = y + z / width;
-                if(w < 0 || d < 0 || w >= width || d >= width)
-                {
-                    fits = false;
-                    break;
-                }
-                w = grids[d * width + w] & 0x1;
-                if(blocks[z] == 1 && w == 1)
-                {
-                    fits = false;
-                    break;
-                }
-            }
-            if(fits)
-            {
-                for(z = 0; placeTo && z < blocks.size(); ++z)
-                {
-                    w = (y + z / width) * width + (x + z % width);
-                    grids[w] |= 1;
-                }
-                return true;
-            }
+            shapeCandidates[x] = {};
+            continue;
         }
+        // a shape turned and put back keeps its orientation in the tray
+        assignBlocks(state.candidates[x], shapeCandidates[x], state.rotation && !shapeCandidates[x].empty() ? shapeCandidates[x].rotation : 0);
     }
-    return false;
 }
 
-void PixelBlast::generateCandidates(bool randomOnly)
+MoveResult PixelBlast::placeMove(const Move &move)
 {
-    int x, y, z, w;
-    QList<std::uint8_t> _virtualGrid = grid;
-    QList<std::uint8_t> _shapes(MaxShapes, 0);
-    QList<int> _candidates(shapeCandidates.size(), 0);
+    int z;
+    Bitboard b;
+    MoveResult result;
+    const GameState &state = engine.state();
+
+    if(!replaying)
+        history.record(engine, move);
+    result = engine.applyMove(move);
+    if(!result.placed)
+        return result;
+
+    // the file is created by the first move, games restarted without a move leave nothing
+    if(!replaying && recordable)
+    {
+        if(!recorder.isOpen())
+            openRecorder();
+        recorder.append(move);
+    }
+    saveGame();
 
-    for(x = 0; x < MaxShapes; ++x)
-        _shapes[x] = x;
+    playSound(SoundPlace[effects.bounded(SoundPlace.size())], 0.5);
 
-    w = static_cast<int>(randomOnly);
-    for(x = 0; x < shapeCandidates.size(); ++x)
+    // Destroyed rows and columns, a crossing cell is destroyed once
+    for(b = result.cleared; b.any();)
+    {
+        z = b.takeFirst();
+        destroyBlocks[destroyCount++] = {BlockObject(z % BoardStride, z / BoardStride, z), state.colors[z]};
+    }
+    if(result.cleared.any())
+        destroyScaler = 1.0F;
+
+    currentShape = {};
+    shapeCandidateIdx = -1;
+    gridHint = {};
+    hintCandidate = -1;
+    syncCandidates();
+    checkDoomed();
+    updateTexts();
+
+    if(engine.isOver())
     {
-        switch(w)
+        // GAME OVER
+        playSound(SoundGameOver, 0.5);
+        recorder.close();
+        // QMessageBox::warning(this, "Game Lost", "Game over!");
+        if(!replaying)
         {
-                // SELECTIVE
-            case 0:
-            {
-                std::shuffle(std::begin(_shapes), std::end(_shapes), *QRandomGenerator::global());
-                for(z = 0; z < MaxShapes; ++z)
-                {
-                    y = getShape(_shapes[z]) & 0x7FFFFFFF;
-                    if(canTrigger(createBlocks(y), _virtualGrid, true))
-                    {
-                        break;
-                    }
-                }
-                break;
-            }
-                // RANDOM
-            case 1:
-            {
-                do
-                {
-                    y = randomShapes();
-                } while(std::any_of(std::begin(_candidates), std::end(_candidates), [y](const auto i) { return i == y; }));
-            }
+            stopGame();
+            emit endOfGame();
         }
-
-        _candidates[x] = y;
-        shapeCandidates[x] = std::make_shared<ShapeBlock>();
-        assignBlocks(createBlocks(y), *shapeCandidates[x]);
     }
+    else if(destroyScaler == 1.0F)
+    {
+        playSound(SoundDestroy, 0.5);
+        playSound(SoundVoice[effects.bounded(SoundVoice.size())], 0.5);
+    }
+    return result;
+}
+
+void PixelBlast::updateTexts()
+{
+    scoreText = QString("Score: %1").arg(engine.state().scores);
+    replayText = QString("Повтор: %1/%2").arg(replayPosition).arg(replay.moves.size());
+    // every change of the game state ends here: the board, the tray and the texts are drawn again
+    invalidate(rect());
+    wakeLoop();
+    emit scoresChanged(engine.state().scores);
 }
 
 void PixelBlast::updateData()
 {
-    cellSquare = qRound(sqrt(grid.size()));
+    if(cellSquare != engine.state().width)
+        staticLayer = {};
+    cellSquare = engine.state().width;
     cellSize = boardRegion.size() / static_cast<float>(cellSquare);
     scaleFactor = {cellScale.width() * cellSize.width(), cellScale.height() * cellSize.height()};
     boardRegion.moveTopLeft({(width() - boardRegion.width()) / 2, (height() - boardRegion.height()) / 2 + 50});
@@ -391,64 +638,88 @@ void PixelBlast::updateData()
 
 void PixelBlast::updateScene()
 {
-    int x, y, z, w, d, i;
+    int x, y, z, w, d, ticks;
+    Bitboard b;
     QPointF tmp, tmp0;
     QRectF dest;
+    const GameState &state = engine.state();
+    std::uint64_t allocations;
+    PB_TRACE_SCOPE("PixelBlast::updateScene");
 
-    mousePoint = mapFromGlobal(QCursor::pos());
-
-    if(currentShape == nullptr && !std::any_of(std::cbegin(shapeCandidates), std::cend(shapeCandidates), [](const auto &t) { return t != nullptr; }))
+    // Allocations of the last frame: its updateScene, paintEvent and the events between them
+    if(allocationTraceEnabled())
     {
-        ++round;
-        generateCandidates(false);
+        allocations = allocationCount() - allocationMark;
+        allocationMax = std::max(allocationMax, allocations);
+        if(frames % 60 == 0)
+        {
+            qDebug() << "allocations per frame: last" << allocations << "max" << allocationMax;
+            allocationMax = 0;
+        }
+        // the report itself is not counted
+        allocationMark = allocationCount();
     }
 
+    profiler.beginFrame();
+    ProfileScope phase(&profiler, ProfilePhase::Logic);
+
     if(destroyScaler == 0.0F)
     {
-        destroyBlocks.clear();
+        destroyCount = 0;
     }
 
-    if(currentShape)
+    for(ticks = advanceTicks(); ticks > 0; --ticks)
     {
-        // Reset old mask
-        d = 0;
-        for(x = 0; x < currentShape->blocks.size(); ++x)
+        // Playback places the recorded moves instead of the mouse
+        if(replaying && frames % ReplayStepFrames == 0 && replayPosition < static_cast<int>(replay.moves.size()))
         {
-            y = currentShape->blocks[x].idx;
-            if(y != -1)
-            {
-                grid[y] = grid[y] & 0x1;
-                ++d;
-            }
-            currentShape->blocks[x].idx = -1;
+            replayPosition = placeMove(replay.moves[replayPosition]).placed ? replayPosition + 1 : static_cast<int>(replay.moves.size());
+            updateTexts();
         }
+        frames++;
+        frameIndex += frames % 5 == 0;
+        destroyScaler = qBound(0.0F, destroyScaler - 0.03F, 1.0F);
+    }
+
+    // the cursor and the buttons of the frame, a placement made here is counted as input
+    phase.next(ProfilePhase::Input);
+    mousePoint = mapFromGlobal(QCursor::pos());
+
+    if(!currentShape.empty())
+    {
+        // Reset old mask
+        d = gridHover.count();
+        gridHover = {};
+        for(x = 0; x < currentShape.count; ++x)
+            currentShape.blocks[x].idx = -1;
 
         // Return selected shape after right click
         if(shapeCandidateIdx != -1 && (mouseDownMode && mouseDownUpped && d == 0 || mouseBtn == Qt::RightButton))
         {
-            shapeCandidates[shapeCandidateIdx] = std::move(currentShape);
+            shapeCandidates[shapeCandidateIdx] = currentShape;
+            currentShape = {};
             shapeCandidateIdx = -1;
         }
     }
 
-    if(currentShape)
+    if(!currentShape.empty())
     {
-        d = 0;
-        tmp.setX(mousePoint.x() - static_cast<float>(currentShape->columns * scaleFactor.width()) / 2);
-        tmp.setY(mousePoint.y() - static_cast<float>(currentShape->rows * scaleFactor.height()) / 2);
-        for(w = 0; w < currentShape->blocks.size(); ++w)
+        b = {};
+        tmp.setX(mousePoint.x() - static_cast<float>(currentShape.columns * scaleFactor.width()) / 2);
+        tmp.setY(mousePoint.y() - static_cast<float>(currentShape.rows * scaleFactor.height()) / 2);
+        for(w = 0; w < currentShape.count; ++w)
         {
-            tmp0 = std::move(currentShape->blocks[w].adjustPoint(tmp, scaleFactor));
+            tmp0 = currentShape.blocks[w].adjustPoint(tmp, scaleFactor);
             x = cellSquare * (tmp0.x() - boardRegion.x() + scaleFactor.width() / 2) / (boardRegion.width());
             y = cellSquare * (tmp0.y() - boardRegion.y() + scaleFactor.height() / 2) / (boardRegion.height());
-            z = y * cellSquare + x;
-            if(x < 0 || y < 0 || x >= cellSquare || y >= cellSquare || (grid[z] & 0x3) != 0 || ((d >> z) & 0x1) == 1)
+            z = y * BoardStride + x;
+            if(x < 0 || y < 0 || x >= cellSquare || y >= cellSquare || (state.occupied | b).test(z))
                 break;
-            d |= 1 << z;
-            currentShape->blocks[w].idx = z;
+            b.set(z);
+            currentShape.blocks[w].idx = z;
         }
         // verification
-        if(w == currentShape->blocks.size())
+        if(w == currentShape.count)
         {
             d = 2;
             if(mouseDownMode)
@@ -456,81 +727,19 @@ void PixelBlast::updateScene()
             else
                 d = (mouseBtn == Qt::LeftButton) ? 1 : d;
 
-            for(x = 0; x < w; ++x)
+            if(d == 2)
             {
-                y = currentShape->blocks[x].idx;
-                grid[y] = d | currentShape->shapeColor << 0x2;
+                gridHover = b;
             }
-
-            // Place complete.
-            if(d == 1)
+            else
             {
-                _res->soundManager->playSound(QString("block-place%1").arg(QRandomGenerator::global()->bounded(2)), 0.5);
-
-                // Test destroy block-points, and optimization
-                for(d = 0; d < currentShape->blocks.size(); ++d)
-                {
-                    x = 0;
-                    y = 0;
-                    w = currentShape->blocks[d].idx % cellSquare;
-                    z = currentShape->blocks[d].idx / cellSquare;
-                    for(i = 0; i < cellSquare; ++i)
-                    {
-                        if((grid[z * cellSquare + i] & 0x3) == 1)
-                            x++;
-
-                        if((grid[i * cellSquare + w] & 0x3) == 1)
-                            y++;
-                    }
-                    if(x == cellSquare)
-                    {
-                        scores += cellSquare;
-                        for(x = 0; x < cellSquare; ++x)
-                        {
-                            i = z * cellSquare + x;
-                            destroyBlocks.append(std::make_pair(std::move(BlockObject(x, z, i)), grid[i] >> 2));
-                            // reset cell
-                            grid[i] = 0x0;
-                        }
-                        destroyScaler = 1.0F;
-                    }
-                    if(y == cellSquare)
-                    {
-                        scores += cellSquare;
-                        for(y = 0; y < cellSquare; ++y)
-                        {
-                            i = y * cellSquare + w;
-                            destroyBlocks.append(std::make_pair(std::move(BlockObject(w, y, i)), grid[i] >> 2));
-                            // reset cell
-                            grid[i] = 0x0;
-                        }
-                        destroyScaler = 1.0F;
-                    }
-                }
-
-                currentShape = nullptr;
-
-                for(x = 0, y = 0, z = 0; x < shapeCandidates.size(); ++x)
-                {
-                    shapeCandidates[x] && ++y && !canTrigger(shapeCandidates[x]->rawBlocks, grid, false) && ++z;
-                }
-                if(y == z && z > 0)
-                {
-                    // GAME OVER
-                    _res->soundManager->playSound("voice-gameover", 0.5);
-                    // QMessageBox::warning(this, "Game Lost", "Game over!");
-                    stopGame();
-                    emit endOfGame();
-                }
-                else if(destroyScaler == 1.0F)
-                {
-                    _res->soundManager->playSound("block-destroy", 0.5);
-                    _res->soundManager->playSound(QString("voice%1").arg(QRandomGenerator::global()->bounded(3)), 0.5);
-                }
+                // Place complete.
+                z = currentShape.blocks[0].idx - getShape(currentShape.shape).cells[0];
+                placeMove({shapeCandidateIdx, z, currentShape.rotation});
             }
         }
     }
-    else if(!shapeCandidates.empty())
+    else if(!replaying && !shapeCandidates.empty())
     {
         // Select candidate block by Mouse Click!
         tmp.setX(0);
@@ -547,150 +756,354 @@ void PixelBlast::updateScene()
         if(!(x < 0 || x == shapeCandidates.size()))
         {
             shapeCandidateIdx = x;
-            if(shapeCandidates[x] && (mouseDownMode && mouseDownUpped || mouseBtn == Qt::LeftButton))
+            if(!shapeCandidates[x].empty() && (mouseDownMode && mouseDownUpped || mouseBtn == Qt::LeftButton))
             {
-                currentShape = std::move(shapeCandidates[x]);
-                _res->soundManager->playSound(QString("block-click%1").arg(QRandomGenerator::global()->bounded(2)), 0.8);
+                currentShape = shapeCandidates[x];
+                shapeCandidates[x] = {};
+                playSound(SoundClick[effects.bounded(SoundClick.size())], 0.8);
             }
         }
     }
 
-    update();
-    frames++;
-    frameIndex += frames % 5 == 0;
-    destroyScaler = qBound(0.0F, destroyScaler - 0.03F, 1.0F);
+    phase.next(ProfilePhase::Logic);
+    updateDirty();
+    if(frameDirty)
+        submitFrame();
 
     if(mouseDownUpped)
         mouseDownUpped = false;
     mouseBtn = 0x0;
+
+    // nothing moves, the next input wakes the loop
+    if(!animating())
+        updateTimer.stop();
 }
 
-void PixelBlast::paintEvent(QPaintEvent *event)
+QRect PixelBlast::cellRect(int cell) const
 {
-    int x, y, z, w;
-    QRectF dest;
-    QPointF destPoint;
-    QPainter p(this);
-    QPixmap *pixmap;
+    QRectF dest(boardRegion.x() + (cell % BoardStride) * scaleFactor.width(), boardRegion.y() + (cell / BoardStride) * scaleFactor.height(), scaleFactor.width(), scaleFactor.height());
+    // the hovered block is drawn 3 pixels larger
+    return (dest + QMarginsF(4, 4, 4, 4)).toAlignedRect();
+}
+
+QRect PixelBlast::trayRect(int slot) const
+{
+    QSizeF size = scaleFactor * (static_cast<float>(cellSquare) / shapeCandidates.size());
+    return QRectF(boardRegion.x() + slot * size.width(), boardRegion.y() + boardRegion.height() + heightOffsetCandidates, size.width(), size.height()).toAlignedRect().adjusted(-1, -1, 1, 1);
+}
 
-    QWidget::paintEvent(event);
+QRect PixelBlast::heldRect() const
+{
+    int size = qRound(scaleFactor.width() * 0.9F);
+    QSize box(currentShape.columns * size, currentShape.rows * size);
+    return QRect(mousePoint - QPoint(box.width() / 2, box.height() / 2), box).adjusted(-1, -1, 1, 1);
+}
 
-    // Draw game logo
-    dest.setSize(_res->gameLogo->size().toSizeF());
-    dest.setHeight(boardRegion.width() * 1.4F / (dest.width() / dest.height()));
-    dest.setWidth(boardRegion.width() * 1.4F);
-    dest.moveTopLeft(boardRegion.topLeft() + QPointF((boardRegion.width() - dest.width()) / 2, -dest.height() / 1.2F));
-    p.drawPixmap(dest, *_res->gameLogo, {});
+QRect PixelBlast::praiseRect(float scale) const
+{
+    QPointF origin(boardRegion.x() - 400 * (1 - scale), boardRegion.y() + (boardRegion.height() + style.praiseFont.pixelSize() * scale) / 2);
+    return QRectF(origin + praiseBounds.topLeft() * scale, praiseBounds.size() * scale).toAlignedRect().adjusted(-2, -2, 2, 2);
+}
 
-    // Draw grid & cells (central)
-    dest = boardRegion;
-    p.drawPixmap(dest + QMarginsF(84, 84, 84, 84), *_res->gridBackgroundBorder, {});
-    p.drawPixmap(dest, *_res->gridBackgroundBg, {});
-    p.drawPixmap(dest, *_res->gridBackground, {});
+void PixelBlast::updateDirty()
+{
+    int x, y, z;
+    bool animate;
+    Bitboard b;
+    QRect rect;
+    const GameState &state = engine.state();
+
+    // invalidate(QRect) merges the rectangles into one repaint and ignores the empty ones, see invalidate()
 
-    destPoint.setX(qFloor(cellSquare * (mousePoint.x() - boardRegion.x()) / (boardRegion.width())));
-    destPoint.setY(qFloor(cellSquare * (mousePoint.y() - boardRegion.y()) / (boardRegion.height())));
+    // the hovered block, the selected tray shape and the dragged shape change their frame
+    animate = drawn.frameIndex != frameIndex;
+    drawn.frameIndex = frameIndex;
 
-    for(z = 0; z < grid.size(); ++z)
+    // Dragged shape, at the old and the new place
+    rect = currentShape.empty() ? QRect() : heldRect();
+    if(rect != drawn.held || currentShape.shape != drawn.heldShape || (animate && !rect.isNull()))
     {
-        x = z % cellSquare;
-        y = z / cellSquare;
-        dest.moveLeft(boardRegion.x() + x * scaleFactor.width());
-        dest.moveTop(boardRegion.y() + y * scaleFactor.height());
-        dest.setSize(scaleFactor);
+        invalidate(drawn.held);
+        invalidate(rect);
+        drawn.held = rect;
+        drawn.heldShape = currentShape.shape;
+    }
 
-        w = grid[z] & 0x3;
-        if(w == 2)
-        {
-            p.setOpacity(1.0D);
-            pixmap = &(*_res->gridCellBright);
-        }
-        else
+    // the overlay shows the last frame
+    if(profiler.enabled())
+        update(profilerRect());
+
+    // Occupied cell under the cursor
+    x = qFloor(cellSquare * (mousePoint.x() - boardRegion.x()) / boardRegion.width());
+    y = qFloor(cellSquare * (mousePoint.y() - boardRegion.y()) / boardRegion.height());
+    z = -1;
+    if(currentShape.empty() && x >= 0 && y >= 0 && x < cellSquare && y < cellSquare && state.occupied.test(y * BoardStride + x))
+        z = y * BoardStride + x;
+    // a new block under the cursor, on the board or in the tray, starts its cycle of frames
+    if(z != drawn.hoverCell || shapeCandidateIdx != drawn.traySelected)
+    {
+        drawn.hoverStart = frameIndex;
+        drawn.hoverFrames = 0;
+        if(z != -1)
+            drawn.hoverFrames = (*_res->BlockRes)[state.colors[z] % _res->BlockRes->size()].frames;
+        else if(shapeCandidateIdx != -1 && !shapeCandidates[shapeCandidateIdx].empty())
+            drawn.hoverFrames = (*_res->BlockRes)[shapeCandidates[shapeCandidateIdx].shapeColor % _res->BlockRes->size()].frames;
+    }
+    if(z != drawn.hoverCell || (animate && z != -1))
+    {
+        if(drawn.hoverCell != -1)
+            invalidate(cellRect(drawn.hoverCell));
+        if(z != -1)
+            invalidate(cellRect(z));
+        drawn.hoverCell = z;
+        if(z != -1 && z != lastSelectedBlock)
         {
-            p.setOpacity(0.3D);
-            pixmap = &(*_res->gridCell);
+            playSound(SoundHits, 0.3);
+            lastSelectedBlock = z;
         }
-        p.drawPixmap(dest, *pixmap, {});
+    }
 
-        if(w == 1)
-        {
-            if(currentShape == nullptr && (x == destPoint.x()) && (y == destPoint.y()))
-            {
-                dest += QMarginsF(3, 3, 3, 3);
-                pixmap = getColoredPixmap(grid[z] >> 2, frameIndex, _res);
-                if(lastSelectedBlock != z)
-                {
-                    _res->soundManager->playSound("block-hits", 0.3);
-                    lastSelectedBlock = z;
-                }
-            }
-            else
-            {
-                pixmap = getColoredPixmap(grid[z] >> 2, 0, _res);
-            }
-            p.setOpacity(1.0D);
-            p.drawPixmap(dest, *pixmap, {});
-        }
+    // Placement preview and hint cells
+    b = currentShape.empty() ? gridHint : Bitboard {};
+    for(b = (gridHover ^ drawn.hover) | (b ^ drawn.hint); b.any();)
+        invalidate(cellRect(b.takeFirst()));
+    drawn.hover = gridHover;
+    drawn.hint = currentShape.empty() ? gridHint : Bitboard {};
+
+    // Tray slots
+    for(z = 0; z < shapeCandidates.size(); ++z)
+    {
+        if(shapeCandidates[z].shape != drawn.tray[z] || ((z == shapeCandidateIdx) != (z == drawn.traySelected)) || ((z == hintCandidate) != (z == drawn.trayHint)) || (animate && z == shapeCandidateIdx))
+            invalidate(trayRect(z));
+        drawn.tray[z] = shapeCandidates[z].shape;
     }
+    drawn.traySelected = shapeCandidateIdx;
+    drawn.trayHint = hintCandidate;
 
-    p.setOpacity(1.0D);
+    // Destroyed blocks and the praise text, the frame after the end clears them
+    rect = destroyScaler > 0 ? praiseRect(destroyScaler) : QRect();
+    if(!rect.isNull() || !drawn.praise.isNull())
+    {
+        invalidate(boardRegion.toAlignedRect());
+        invalidate(drawn.praise);
+        invalidate(rect);
+        // the warning shows up when the praise is gone
+        invalidate(QRectF(boardRegion.x(), boardRegion.y() - 60, boardRegion.width(), 50).toAlignedRect());
+        drawn.praise = rect;
+    }
+}
 
-    // Draw blocks
-    dest.moveTopLeft(boardRegion.topLeft());
-    dest.setSize(scaleFactor);
-    destPoint = dest.topLeft();
-    y = dest.size().width() / 2;
-    for(x = 0; x < destroyBlocks.size(); ++x)
+void PixelBlast::renderStaticLayer(const FrameSnapshot &frame)
+{
+    staticLayer = QPixmap(size() * devicePixelRatioF());
+    staticLayer.setDevicePixelRatio(devicePixelRatioF());
+    QPainter p(&staticLayer);
+    drawStaticLayer(p, frame, *_res->staticSources, *_res->atlas);
+}
+
+void PixelBlast::snapshot(FrameSnapshot &frame) const
+{
+    int x, y;
+    const GameState &state = engine.state();
+
+    frame.size = size();
+    frame.ratio = devicePixelRatioF();
+    frame.boardRegion = boardRegion;
+    frame.scaleFactor = scaleFactor;
+    frame.cellSquare = cellSquare;
+    frame.heightOffsetCandidates = heightOffsetCandidates;
+    frame.mousePoint = mousePoint;
+    frame.occupied = state.occupied;
+    frame.colors = state.colors;
+    frame.hover = gridHover;
+    frame.hint = currentShape.empty() ? gridHint : Bitboard {};
+
+    x = qFloor(cellSquare * (mousePoint.x() - boardRegion.x()) / boardRegion.width());
+    y = qFloor(cellSquare * (mousePoint.y() - boardRegion.y()) / boardRegion.height());
+    frame.hoverCell = -1;
+    if(currentShape.empty() && x >= 0 && y >= 0 && x < cellSquare && y < cellSquare && state.occupied.test(y * BoardStride + x))
+        frame.hoverCell = y * BoardStride + x;
+
+    frame.frameIndex = frameIndex;
+    frame.destroyScaler = destroyScaler;
+    frame.destroyCount = destroyCount;
+    std::copy_n(destroyBlocks.begin(), destroyCount, frame.destroyBlocks.begin());
+    frame.tray = shapeCandidates;
+    frame.traySelected = shapeCandidateIdx;
+    frame.trayHint = hintCandidate;
+    frame.held = currentShape;
+    frame.doomed = doomed;
+    frame.replaying = replaying;
+    frame.scoreText = scoreText;
+    frame.replayText = replayText;
+}
+
+void PixelBlast::invalidate(const QRect &rect)
+{
+    if(composer == nullptr)
     {
-        const auto &db = destroyBlocks[x];
-        dest.moveTopLeft(db.first.adjustPoint(destPoint, dest.size()));
-        pixmap = getColoredPixmap(db.second, 0, _res);
-        p.drawPixmap(dest.marginsRemoved(QMarginsF(y * (1 - destroyScaler), y * (1 - destroyScaler), y * (1 - destroyScaler), y * (1 - destroyScaler))), *pixmap, {});
+        update(rect);
+        return;
     }
+    // the frame loop sends the frame when it ends, without it the change goes now
+    frameDirty = true;
+    if(!updateTimer.isActive())
+        submitFrame();
+}
+
+void PixelBlast::submitFrame()
+{
+    FrameSnapshot frame;
+    frameDirty = false;
+    if(composer == nullptr)
+        return;
+    snapshot(frame);
+    composer->submit(frame);
+}
 
-    // Draw bottom INVENTORY
-    dest.moveTopLeft(boardRegion.topLeft() + QPointF(0, boardRegion.height() + heightOffsetCandidates));
-    dest.setSize(scaleFactor * (static_cast<float>(cellSquare) / shapeCandidates.size()));
-    if(shapeCandidateIdx != -1 && shapeCandidates[shapeCandidateIdx])
+void PixelBlast::setThreadedRendering(bool value)
+{
+    threaded = value;
+    // resourcesLoaded() calls it again
+    if(!_res || value == (composer != nullptr))
+        return;
+    if(value)
+    {
+        composer = new FrameComposer(style, _res, this);
+        QObject::connect(composer, &FrameComposer::frameReady, this, qOverload<>(&QWidget::update));
+        submitFrame();
+    }
+    else
     {
-        // tmpPixmap = std::move(adjustBright(*getColoredPixmap((*shapeCandidates[shapeCandidateIdx]).shapeColor, frameIndex), 60));
-        pixmap = getColoredPixmap((*shapeCandidates[shapeCandidateIdx]).shapeColor, frameIndex, _res);
+        delete composer;
+        composer = nullptr;
+        update();
     }
+}
 
-    for(z = 0; z < shapeCandidates.size(); ++z)
+bool PixelBlast::threadedRendering()
+{
+    return threaded;
+}
+
+void PixelBlast::playSound(const QString &name, qreal volume)
+{
+    ProfileScope phase(&profiler, ProfilePhase::Sound);
+    if(_res)
+        _res->soundManager->playSound(name, volume);
+}
+
+void PixelBlast::setProfileDirectory(const QString &path)
+{
+    profileDirectory = path;
+}
+
+void PixelBlast::exportProfile()
+{
+    QString path;
+    if(profileDirectory.isEmpty())
+        return;
+    path = QString("%1/profile-%2.csv").arg(profileDirectory, QDateTime::currentDateTime().toString("yyyyMMdd-hhmmss"));
+    if(profiler.writeCsv(QFile::encodeName(path).constData()))
+        qDebug() << "Frame profile:" << path;
+    else
+        qWarning() << "Frame profile is not written:" << path;
+}
+
+QRect PixelBlast::profilerRect() const
+{
+    return QRect(8, 8, ProfileFrames + 16, 96 + ProfilePhaseCount * 14);
+}
+
+void PixelBlast::drawProfiler(QPainter &p)
+{
+    // Colors of the phases in the graph and the legend
+    static const std::array<QColor, ProfilePhaseCount> PhaseColors = {QColor(0x4F, 0xC3, 0xF7), QColor(0x81, 0xC7, 0x84), QColor(0xFF, 0xD5, 0x4F), QColor(0x90, 0xA4, 0xAE), QColor(0xBA, 0x68, 0xC8), QColor(0xFF, 0x8A, 0x65), QColor(0x4D, 0xB6, 0xAC), QColor(0xF0, 0x62, 0x92), QColor(0xE0, 0xE0, 0xE0)};
+    // Height of the graph, 20 ms at the top
+    constexpr int GraphHeight = 80;
+    constexpr double GraphScale = GraphHeight / 20e6;
+    int x, y, h, top;
+    QRect box;
+    if(!profiler.enabled())
+        return;
+
+    box = profilerRect();
+    p.save();
+    p.resetTransform();
+    p.setOpacity(1.0);
+    p.fillRect(box, QColor(0, 0, 0, 190));
+
+    // one column per frame, the newest on the right, the phases stacked from the bottom
+    for(x = 0; x < profiler.sampleCount(); ++x)
     {
-        p.drawPixmap(dest, *_res->gridCell, {});
-        if(shapeCandidates[z])
+        const ProfileSample &sample = profiler.sample(x);
+        top = box.top() + 8 + GraphHeight;
+        for(y = 0; y < ProfilePhaseCount && top > box.top() + 8; ++y)
         {
-            destPoint.setX(scaleFactor.width() * 0.6F * shapeCandidates[z]->columns);
-            destPoint.setY(scaleFactor.height() * 0.6F * shapeCandidates[z]->rows);
-            destPoint = dest.topLeft() + QPointF((dest.width() - destPoint.x()) / 2, (dest.height() - destPoint.y()) / 2);
-            drawShapeAt(*shapeCandidates[z], destPoint, scaleFactor * 0.6F, 0, p, _res, ((z == shapeCandidateIdx) ? pixmap : nullptr));
+            h = qMin(top - box.top() - 8, qCeil(sample.phases[y] * GraphScale));
+            if(h <= 0)
+                continue;
+            p.fillRect(box.right() - 8 - x, top - h, 1, h, PhaseColors[y]);
+            top -= h;
         }
-        dest.moveLeft(dest.x() + dest.width());
     }
+    // the budget of a 60 Hz frame
+    y = box.top() + 8 + GraphHeight - qRound(16.7e6 * GraphScale);
+    p.setPen(QColor(255, 255, 255, 120));
+    p.drawLine(box.left() + 8, y, box.right() - 8, y);
 
-    // Draw blocks by select pointer
-    if(currentShape)
+    p.setFont(style.font);
+    for(y = 0; y < ProfilePhaseCount; ++y)
     {
-        p.setOpacity(0.8D);
-        dest.setSize(scaleFactor * 0.9F);
-        destPoint = {mousePoint.x() - static_cast<float>(currentShape->columns * dest.width()) / 2, mousePoint.y() - static_cast<float>(currentShape->rows * dest.height()) / 2};
-        drawShapeAt(*currentShape, destPoint, dest.size(), frameIndex, p, _res);
+        p.setPen(PhaseColors[y]);
+        p.drawText(box.left() + 8, box.top() + GraphHeight + 26 + y * 14,
+                   QString("%1  %2 ms  max %3 ms").arg(QLatin1String(FrameProfiler::phaseName(static_cast<ProfilePhase>(y))), -8).arg(profiler.average(static_cast<ProfilePhase>(y)) / 1e6, 0, 'f', 3).arg(profiler.maximum(static_cast<ProfilePhase>(y)) / 1e6, 0, 'f', 3));
     }
+    p.restore();
+}
 
-    p.drawText(QPoint {10, 200}, QString("Score: ") + QString::number(scores));
+void PixelBlast::paintEvent(QPaintEvent *event)
+{
+    FrameSnapshot frame;
+    QPainter p(this);
+    ProfileScope phase(&profiler, ProfilePhase::Grid);
+    PB_TRACE_SCOPE("PixelBlast::paintEvent");
+
+    if(!_res)
+    {
+        p.fillRect(rect(), palette().brush(QPalette::Window));
+        return;
+    }
+#ifdef PB_TRACE
+    static bool firstFrame = true;
+    // the startup span of main() ends at the first frame on the screen
+    if(firstFrame)
+    {
+        firstFrame = false;
+        PB_TRACE_END("startup", 0);
+    }
+#endif
 
-    // DRAW TEXT
-    if(destroyScaler > 0)
+    if(composer != nullptr)
     {
-        auto font = p.font();
-        font.setPixelSize(128 * destroyScaler);
-        p.setFont(font);
-        destPoint.setX(boardRegion.x() - 400 * (1 - destroyScaler));
-        destPoint.setY(boardRegion.y() + (boardRegion.height() + font.pixelSize()) / 2);
-        p.drawText(destPoint, "МОЛОДЕЦ!");
+        // the worker drew the frame, a resize shows the last one until the next is done
+        if(!composer->present(p))
+            p.fillRect(rect(), palette().brush(QPalette::Window));
+        drawProfiler(p);
+        return;
     }
+
+    // the same snapshot the composer thread draws from, both modes show the same frame
+    snapshot(frame);
+
+    // a move to a screen of another pixel ratio needs a new layer and new sprites as well
+    _res->atlas->setDevicePixelRatio(devicePixelRatioF());
+    if(staticLayer.isNull() || staticLayer.deviceIndependentSize() != size() || staticLayer.devicePixelRatio() != devicePixelRatioF())
+        renderStaticLayer(frame);
+    p.drawPixmap(0, 0, staticLayer);
+
+    composeFrame(p, frame, *_res->atlas, style, *_res, &profiler);
+    drawProfiler(p);
 }
 
 QPointF BlockObject::adjustPoint(const QPointF &adjust, const QSizeF &scale) const
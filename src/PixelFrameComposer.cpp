@@ -0,0 +1,268 @@
+#include <QMutexLocker>
+#include <QtMath>
+
+#include "PixelFrameComposer.h"
+#include "PixelTrace.h"
+
+inline int blockSprite(int color, int frameIndex, const PGlobalResources &res, bool highlight = false)
+{
+    // a pack of fewer colors than the game was started with repeats its colors
+    const BlockResource &br = (*res.BlockRes)[color % res.BlockRes->size()];
+    return (highlight ? br.highlight : br.sprite) + frameIndex % br.frames;
+}
+
+// Add every block of the shape to the atlas layer, blocks are size pixels apart
+inline void addShapeAt(const ShapeBlock &shape, QPoint destPoint, int size, int sprite, SpriteAtlas &atlas, qreal opacity = 1.0)
+{
+    int x;
+    for(x = 0; x < shape.count; ++x)
+        atlas.add(sprite, destPoint + QPoint(shape.blocks[x].x * size, shape.blocks[x].y * size), opacity);
+};
+
+void drawStaticLayer(QPainter &p, const FrameSnapshot &frame, const StaticSources &sources, SpriteAtlas &atlas)
+{
+    int z;
+    QRectF dest;
+
+    p.fillRect(QRect(QPoint(0, 0), frame.size), sources.window);
+
+    // Draw game logo
+    dest.setSize(sources.logo.size().toSizeF());
+    dest.setHeight(frame.boardRegion.width() * 1.4F / (dest.width() / dest.height()));
+    dest.setWidth(frame.boardRegion.width() * 1.4F);
+    dest.moveTopLeft(frame.boardRegion.topLeft() + QPointF((frame.boardRegion.width() - dest.width()) / 2, -dest.height() / 1.2F));
+    p.drawImage(dest, sources.logo);
+
+    // Draw grid & empty cells (central)
+    dest = frame.boardRegion;
+    p.drawImage(dest + QMarginsF(84, 84, 84, 84), sources.gridBorder);
+    p.drawImage(dest, sources.gridBackgroundBg);
+    p.drawImage(dest, sources.gridBackground);
+
+    // the same integer cells as the blocks drawn over them
+    atlas.begin(qRound(frame.scaleFactor.width()));
+    for(z = 0; z < frame.cellSquare * frame.cellSquare; ++z)
+        atlas.add(SpriteGridCell, QPointF(frame.boardRegion.x() + (z % frame.cellSquare) * frame.scaleFactor.width(), frame.boardRegion.y() + (z / frame.cellSquare) * frame.scaleFactor.height()).toPoint(), 0.3D);
+    atlas.draw(p);
+}
+
+void composeFrame(QPainter &p, const FrameSnapshot &frame, SpriteAtlas &atlas, const FrameStyle &style, const PGlobalResources &res, FrameProfiler *profiler)
+{
+    int x, y, z, w, i, d;
+    QPoint point;
+    QPointF destPoint;
+    Bitboard cells;
+    const QRectF &boardRegion = frame.boardRegion;
+    const QSizeF &scaleFactor = frame.scaleFactor;
+    const int traySize = static_cast<int>(frame.tray.size());
+    ProfileScope phase(profiler, ProfilePhase::Cells);
+
+    p.setFont(style.font);
+    p.setPen(style.textColor);
+
+    // every layer is one batch of unscaled sprites at integer points, cell size d
+    d = qRound(scaleFactor.width());
+
+    // only the cells that differ from the static layer
+    cells = frame.occupied | frame.hover | frame.hint;
+    atlas.begin(d);
+    while(cells.any())
+    {
+        i = cells.takeFirst();
+        x = i % BoardStride;
+        y = i / BoardStride;
+        point = QPointF(boardRegion.x() + x * scaleFactor.width(), boardRegion.y() + y * scaleFactor.height()).toPoint();
+
+        w = frame.hover.test(i) ? 2 : static_cast<int>(frame.occupied.test(i));
+        if(w == 2)
+            atlas.add(SpriteGridCellBright, point);
+        else if(w == 0)
+            atlas.add(SpriteGridCellBright, point, 0.6D); // hinted empty cell
+        else if(i != frame.hoverCell)
+            atlas.add(blockSprite(frame.colors[i], 0, res), point);
+    }
+    atlas.draw(p);
+
+    // drawn larger on top of the others
+    z = frame.hoverCell;
+    if(z != -1)
+    {
+        point = QPointF(boardRegion.x() + (z % BoardStride) * scaleFactor.width(), boardRegion.y() + (z / BoardStride) * scaleFactor.height()).toPoint();
+        atlas.begin(d + 6);
+        atlas.add(blockSprite(frame.colors[z], frame.frameIndex, res), point - QPoint(3, 3));
+        atlas.draw(p);
+    }
+
+    // Draw blocks, shrinking to their centers: cells of size d under the scale of the painter,
+    // an atlas scaled to every size of the animation would be built in the frame loop
+    phase.next(ProfilePhase::Destroy);
+    if(frame.destroyScaler > 0 && frame.destroyCount > 0)
+    {
+        p.setTransform(QTransform::fromScale(frame.destroyScaler, frame.destroyScaler));
+        p.setRenderHint(QPainter::SmoothPixmapTransform);
+        atlas.begin(d);
+        for(x = 0; x < frame.destroyCount; ++x)
+        {
+            const DestroyBlock &db = frame.destroyBlocks[x];
+            destPoint = QPointF(boardRegion.x() + (db.block.x + 0.5) * scaleFactor.width(), boardRegion.y() + (db.block.y + 0.5) * scaleFactor.height()) / frame.destroyScaler;
+            atlas.add(blockSprite(db.color, 0, res), (destPoint - QPointF(d / 2.0, d / 2.0)).toPoint());
+        }
+        atlas.draw(p);
+        p.setRenderHint(QPainter::SmoothPixmapTransform, false);
+        p.resetTransform();
+    }
+
+    // Draw bottom INVENTORY: the slots, then the shapes in them
+    phase.next(ProfilePhase::Tray);
+    w = qRound(scaleFactor.width() * frame.cellSquare / traySize);
+    atlas.begin(w);
+    for(z = 0; z < traySize; ++z)
+    {
+        point = (boardRegion.topLeft() + QPointF(z * scaleFactor.width() * frame.cellSquare / traySize, boardRegion.height() + frame.heightOffsetCandidates)).toPoint();
+        atlas.add((z == frame.trayHint) ? SpriteGridCellBright : SpriteGridCell, point);
+    }
+    atlas.draw(p);
+
+    d = qRound(scaleFactor.width() * 0.6F);
+    atlas.begin(d);
+    for(z = 0; z < traySize; ++z)
+    {
+        const ShapeBlock &shape = frame.tray[z];
+        if(shape.empty())
+            continue;
+        point = (boardRegion.topLeft() + QPointF(z * scaleFactor.width() * frame.cellSquare / traySize, boardRegion.height() + frame.heightOffsetCandidates)).toPoint();
+        point += QPoint((w - d * shape.columns) / 2, (w - d * shape.rows) / 2);
+        // the selected shape is animated
+        addShapeAt(shape, point, d, blockSprite(shape.shapeColor, (z == frame.traySelected) ? frame.frameIndex : 0, res, z == frame.traySelected), atlas);
+    }
+    atlas.draw(p);
+
+    // Draw blocks by select pointer
+    phase.next(ProfilePhase::Held);
+    if(!frame.held.empty())
+    {
+        d = qRound(scaleFactor.width() * 0.9F);
+        point = frame.mousePoint - QPoint(frame.held.columns * d / 2, frame.held.rows * d / 2);
+        atlas.begin(d);
+        addShapeAt(frame.held, point, d, blockSprite(frame.held.shapeColor, frame.frameIndex, res), atlas, 0.8D);
+        atlas.draw(p);
+    }
+
+    phase.next(ProfilePhase::Text);
+    p.drawText(QPoint {10, 200}, frame.scoreText);
+    if(frame.replaying)
+        p.drawText(QPoint {10, 220}, frame.replayText);
+
+    // DRAW TEXT
+    if(frame.destroyScaler > 0)
+    {
+        // the painter scales the text, a new pixel size every frame would build a new font
+        p.setFont(style.praiseFont);
+        destPoint.setX(boardRegion.x() - 400 * (1 - frame.destroyScaler));
+        destPoint.setY(boardRegion.y() + (boardRegion.height() + style.praiseFont.pixelSize() * frame.destroyScaler) / 2);
+        p.setTransform(QTransform(frame.destroyScaler, 0, 0, frame.destroyScaler, destPoint.x(), destPoint.y()));
+        p.drawText(QPointF(0, 0), style.praise);
+        p.resetTransform();
+    }
+    else if(frame.doomed)
+    {
+        // early warning: the round can not be finished whatever the order
+        p.setFont(style.warningFont);
+        p.setPen(Qt::red);
+        p.drawText(QRectF(boardRegion.x(), boardRegion.y() - 60, boardRegion.width(), 50), Qt::AlignCenter, style.doomed);
+    }
+}
+
+FrameComposer::FrameComposer(const FrameStyle &style, std::shared_ptr<PGlobalResources> res, QObject *parent) : QObject(parent), m_style(style), m_res(std::move(res))
+{
+    m_atlas.setSprites(*m_res->atlas);
+    m_thread.reset(QThread::create([this]() { run(); }));
+    m_thread->setObjectName("FrameComposer");
+    m_thread->start();
+}
+
+FrameComposer::~FrameComposer()
+{
+    {
+        QMutexLocker lock(&m_pendingMutex);
+        m_stop = true;
+        m_wake.wakeOne();
+    }
+    m_thread->wait();
+}
+
+void FrameComposer::submit(const FrameSnapshot &frame)
+{
+    QMutexLocker lock(&m_pendingMutex);
+    // a frame the worker has not started yet is replaced
+    m_pending = frame;
+    m_scheduled = true;
+    m_wake.wakeOne();
+}
+
+bool FrameComposer::present(QPainter &painter)
+{
+    QMutexLocker lock(&m_bufferMutex);
+    if(m_ready == -1)
+        return false;
+    painter.drawImage(0, 0, m_buffers[m_ready]);
+    return true;
+}
+
+void FrameComposer::run()
+{
+    PB_TRACE_THREAD("FrameComposer");
+    for(;;)
+    {
+        {
+            QMutexLocker lock(&m_pendingMutex);
+            while(!m_scheduled && !m_stop)
+                m_wake.wait(&m_pendingMutex);
+            if(m_stop)
+                return;
+            m_frame = m_pending;
+            m_scheduled = false;
+        }
+        compose();
+    }
+}
+
+void FrameComposer::compose()
+{
+    int back;
+    QSize pixels = m_frame.size * m_frame.ratio;
+    PB_TRACE_SCOPE("FrameComposer::compose");
+    if(pixels.isEmpty())
+        return;
+
+    m_atlas.setDevicePixelRatio(m_frame.ratio);
+    // the layer of the widget is dropped by a resize or another board size, this one compares them
+    if(m_staticLayer.size() != pixels || m_staticLayer.devicePixelRatio() != m_frame.ratio || m_staticBoard != m_frame.boardRegion || m_staticCells != m_frame.cellSquare)
+    {
+        m_staticBoard = m_frame.boardRegion;
+        m_staticCells = m_frame.cellSquare;
+        m_staticLayer = QImage(pixels, QImage::Format_ARGB32_Premultiplied);
+        m_staticLayer.setDevicePixelRatio(m_frame.ratio);
+        QPainter layer(&m_staticLayer);
+        drawStaticLayer(layer, m_frame, *m_res->staticSources, m_atlas);
+    }
+
+    // only this thread changes m_ready, the other buffer is not read by the widget
+    back = m_ready == 0 ? 1 : 0;
+    QImage &buffer = m_buffers[back];
+    if(buffer.size() != pixels || buffer.devicePixelRatio() != m_frame.ratio)
+    {
+        buffer = QImage(pixels, QImage::Format_ARGB32_Premultiplied);
+        buffer.setDevicePixelRatio(m_frame.ratio);
+    }
+    QPainter p(&buffer);
+    p.drawImage(0, 0, m_staticLayer);
+    composeFrame(p, m_frame, m_atlas, m_style, *m_res);
+    p.end();
+
+    {
+        QMutexLocker lock(&m_bufferMutex);
+        m_ready = back;
+    }
+    emit frameReady();
+}
@@ -5,6 +5,7 @@
 #include <QNetworkRequest>
 
 #include "PixelNetwork.h"
+#include "PixelTrace.h"
 
 #ifndef CALLBACK_URL
 constexpr char CallbackUrl[] = "https://example.com/callback";
@@ -43,6 +44,8 @@ void PixelNetwork::newClient(QString nickname)
     json["name"] = nickname;
     json["maxPoints"] = 0;
     reply = manager->post(QNetworkRequest(QUrl(CallbackUrl)), QJsonDocument(json).toJson(QJsonDocument::Compact));
+    // the span of a request lasts until its reply is handled
+    PB_TRACE_BEGIN("network.current", reply);
     QObject::connect(reply, &QNetworkReply::finished, this, &PixelNetwork::onReplyCurrent);
 }
 
@@ -55,12 +58,14 @@ void PixelNetwork::updateStats(PixelStats stat)
     json["name"] = stat.name;
     json["maxPoints"] = stat.maxPoints;
     reply = manager->post(QNetworkRequest(QUrl(CallbackUrl)), QJsonDocument(json).toJson(QJsonDocument::Compact));
+    PB_TRACE_BEGIN("network.current", reply);
     QObject::connect(reply, &QNetworkReply::finished, this, &PixelNetwork::onReplyCurrent);
 }
 
 void PixelNetwork::readStats()
 {
     QNetworkReply *reply = manager->get(QNetworkRequest(QUrl(CallbackUrl)));
+    PB_TRACE_BEGIN("network.stats", reply);
     QObject::connect(reply, &QNetworkReply::finished, this, &PixelNetwork::onReplyStats);
 }
 
@@ -76,8 +81,10 @@ void PixelNetwork::onReplyCurrent()
     PixelStats curStat {};
     NetworkResultFlags state = NetworkResultFlags::NoNetwork;
     QNetworkReply *reply = qobject_cast<QNetworkReply *>(sender());
+    PB_TRACE_SCOPE("PixelNetwork::onReplyCurrent");
     if(reply)
     {
+        PB_TRACE_END("network.current", reply);
         if(reply->error() == QNetworkReply::NoError)
         {
             QJsonDocument jdoc = QJsonDocument::fromJson(reply->readAll());
@@ -103,8 +110,10 @@ void PixelNetwork::onReplyStats()
     QList<PixelStats> stats {};
     NetworkResultFlags state = NetworkResultFlags::NoNetwork;
     QNetworkReply *reply = qobject_cast<QNetworkReply *>(sender());
+    PB_TRACE_SCOPE("PixelNetwork::onReplyStats");
     if(reply)
     {
+        PB_TRACE_END("network.stats", reply);
         if(reply->error() == QNetworkReply::NoError)
         {
             QJsonDocument jdoc = QJsonDocument::fromJson(reply->readAll());
@@ -0,0 +1,341 @@
+#include <cstdint>
+#include <stdexcept>
+
+#include <QDebug>
+#include <QFile>
+#include <QTextStream>
+#include <QUrl>
+
+#include "PixelResourceLoader.h"
+#include "PixelSoundManager.h"
+#include "PixelTrace.h"
+
+// The bundle made by pixelblast_bundle, see src/CMakeLists.txt
+extern const unsigned char PixelBundleData[];
+extern const std::size_t PixelBundleSize;
+
+// Wait of the reload after the last change of a pack
+constexpr int PackReloadDelay = 250;
+
+enum ImageIndex
+{
+    ImageLogo,
+    ImageTopHeader,
+    ImageBackground,
+    ImageCursor,
+    ImageGridBorder,
+    ImageGridBackground,
+    ImageGridBackgroundBg,
+    // Filtered grid cell, the variant is the bright one
+    ImageGridCell,
+    ImageCount
+};
+
+// Names in the qrc under /pixelblastgame and in the bundle
+static const char *ImageNames[ImageCount] = {"game-logo", "ui-top", "background", "arrow", "grid-border", "grid-background", "grid-background-bg", "grid-cell"};
+
+static const QString BlocksPath = QStringLiteral(":/pixelblastgame/resourcepacks/blocks/");
+
+// Run the filter over every scanline of the image
+static void filterImage(QImage &img, const ImageFilter &filter)
+{
+    int y;
+    img = std::move(img).convertToFormat(QImage::Format_ARGB32_Premultiplied);
+    for(y = 0; y < img.height(); ++y)
+        filter.apply(reinterpret_cast<std::uint32_t *>(img.scanLine(y)), img.width());
+}
+
+ResourceLoader *ResourceLoader::instance()
+{
+    static ResourceLoader loader;
+    return &loader;
+}
+
+ResourceLoader::ResourceLoader() : QObject(nullptr)
+{
+    m_pool.setObjectName("ResourceLoader");
+    m_reloadTimer.setSingleShot(true);
+    m_reloadTimer.setInterval(PackReloadDelay);
+    QObject::connect(&m_reloadTimer, &QTimer::timeout, this, &ResourceLoader::reload);
+    QObject::connect(&m_watcher, &QFileSystemWatcher::fileChanged, &m_reloadTimer, qOverload<>(&QTimer::start));
+    PB_TRACE_BEGIN("resources", this);
+    loadLibrary();
+}
+
+ResourceLoader::~ResourceLoader()
+{
+    m_pool.waitForDone();
+}
+
+bool ResourceLoader::isReady() const
+{
+    return m_resources != nullptr;
+}
+
+std::shared_ptr<PGlobalResources> ResourceLoader::resources() const
+{
+    return m_resources;
+}
+
+int ResourceLoader::colorCount() const
+{
+    return static_cast<int>(m_resources != nullptr ? m_resources->BlockRes->size() : m_blocks.size());
+}
+
+void ResourceLoader::setPack(const QString &path)
+{
+    if(path == m_pack)
+        return;
+    if(!m_watcher.files().isEmpty())
+        m_watcher.removePaths(m_watcher.files());
+    m_pack = path;
+    reload();
+}
+
+QString ResourceLoader::pack() const
+{
+    return m_pack;
+}
+
+void ResourceLoader::loadLibrary()
+{
+    int x, frames;
+    QString content;
+    QStringList fields;
+    ImageFilter highlight;
+    PB_TRACE_SCOPE("ResourceLoader::loadLibrary");
+
+    // the array is defined on a BundleAlign boundary, a QImage needs aligned words
+    Q_ASSERT(reinterpret_cast<std::uintptr_t>(PixelBundleData) % BundleAlign == 0);
+    if(openBundle(PixelBundleData, static_cast<qint64>(PixelBundleSize), nullptr))
+    {
+        m_decoding = true;
+        m_pool.start([this]() { prepare(); });
+        return;
+    }
+
+    // a bundle that is not valid decodes the PNGs of the qrc
+    QFile file(BlocksPath + "blocks.cfg");
+    if(!file.open(QFile::ReadOnly | QFile::Text))
+        throw std::runtime_error("Resource is not access");
+
+    m_jobs.resize(ImageCount);
+    for(x = 0; x < ImageCount; ++x)
+        m_jobs[x].path = QString(":/pixelblastgame/") + ImageNames[x];
+    m_jobs[ImageGridCell].filter.brightness(GridCellBrightness);
+    m_jobs[ImageGridCell].variantFilter.brightness(GridCellBrightBrightness);
+
+    // every frame of every color, the selected candidate of the tray is drawn highlighted
+    highlight.brightness(HighlightBrightness);
+    QTextStream stream(&file);
+    while(stream.readLineInto(&content))
+    {
+        // name, frame count and the file name with # for the frame number from 1
+        fields = content.split(' ', Qt::SkipEmptyParts);
+        if(fields.size() != 3 || (frames = fields[1].toInt()) < 1)
+            throw std::runtime_error("Resource is not valid");
+        m_blocks.append(BlockResource {fields[0], frames});
+        for(x = 0; x < frames; ++x)
+        {
+            ImageJob job;
+            job.path = BlocksPath + QString(fields[2]).replace(QChar('#'), QString::number(x + 1));
+            job.variantFilter = highlight;
+            m_jobs.push_back(std::move(job));
+        }
+    }
+
+    // m_jobs is not resized from here on, the tasks write their own elements
+    m_remaining = static_cast<int>(m_jobs.size());
+    m_decoding = true;
+    for(x = 0; x < static_cast<int>(m_jobs.size()); ++x)
+        m_pool.start([this, x]() { decode(x); });
+}
+
+bool ResourceLoader::openBundle(const uchar *data, qint64 size, std::shared_ptr<void> storage)
+{
+    int x, y, bright;
+    SpriteBundle bundle;
+    PB_TRACE_SCOPE("ResourceLoader::openBundle");
+    if(!bundle.open(data, static_cast<std::size_t>(size)))
+        return false;
+
+    auto wrap = [&bundle](int index) {
+        const BundleImage &image = bundle.image(index);
+        return QImage(reinterpret_cast<const uchar *>(image.pixels), image.width, image.height, image.stride, QImage::Format_ARGB32_Premultiplied);
+    };
+    clearJobs();
+    m_jobs.resize(ImageCount);
+    for(x = 0; x < ImageCount; ++x)
+    {
+        if((y = bundle.findImage(ImageNames[x])) == -1)
+        {
+            clearJobs();
+            return false;
+        }
+        m_jobs[x].image = wrap(y);
+    }
+    if((bright = bundle.findImage(BundleGridCellBright)) == -1 || bundle.blockCount() == 0)
+    {
+        clearJobs();
+        return false;
+    }
+    m_jobs[ImageGridCell].variant = wrap(bright);
+    for(x = 0; x < bundle.blockCount(); ++x)
+    {
+        const BundleBlock &block = bundle.block(x);
+        m_blocks.append(BlockResource {QString::fromStdString(block.name), block.frames});
+        for(y = 0; y < block.frames; ++y)
+        {
+            ImageJob job;
+            job.image = wrap(block.image + y);
+            job.variant = wrap(block.highlight + y);
+            m_jobs.push_back(std::move(job));
+        }
+    }
+    m_storage = std::move(storage);
+    return true;
+}
+
+void ResourceLoader::clearJobs()
+{
+    m_jobs.clear();
+    m_blocks.clear();
+    m_storage.reset();
+}
+
+void ResourceLoader::reload()
+{
+    uchar *data;
+    std::shared_ptr<QFile> file;
+    PB_TRACE_SCOPE("ResourceLoader::reload");
+    // the PNGs of the library are still decoded, the pack follows them
+    if(m_decoding)
+    {
+        m_reloadTimer.start();
+        return;
+    }
+    if(m_pack.isEmpty())
+    {
+        loadLibrary();
+        return;
+    }
+
+    // a pack replaced by a rename is a new file, the watcher has dropped the old one
+    if(!m_watcher.files().contains(m_pack))
+        m_watcher.addPath(m_pack);
+    // the mapping lives as long as the file object, the resources made from it keep both
+    file = std::make_shared<QFile>(m_pack);
+    if(file->open(QFile::ReadOnly) && (data = file->map(0, file->size())) != nullptr && openBundle(data, file->size(), file))
+    {
+        m_decoding = true;
+        m_pool.start([this]() { prepare(); });
+        return;
+    }
+    qWarning() << "resource pack is not valid:" << m_pack;
+}
+
+void ResourceLoader::decode(int index)
+{
+    ImageJob &job = m_jobs[index];
+    PB_TRACE_SCOPE("ResourceLoader::decode");
+    job.image.load(job.path);
+    if(!job.filter.empty())
+        filterImage(job.image, job.filter);
+    if(!job.variantFilter.empty())
+    {
+        job.variant = job.image;
+        filterImage(job.variant, job.variantFilter);
+    }
+    // the last image goes on with the atlas on its own thread
+    if(m_remaining.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        prepare();
+}
+
+void ResourceLoader::prepare()
+{
+    int x, y, next = ImageCount;
+    QList<QImage> sprites {m_jobs[ImageGridCell].image, m_jobs[ImageGridCell].variant};
+    PB_TRACE_SCOPE("ResourceLoader::prepare");
+
+    // one atlas for every sprite drawn per frame: the grid cells, then every frame of every color, plain
+    // and highlighted. Drawing it here reads the sprites of a mapped pack from the disk off the GUI thread
+    for(x = 0; x < m_blocks.size(); ++x)
+    {
+        BlockResource &br = m_blocks[x];
+        br.sprite = sprites.size();
+        for(y = 0; y < br.frames; ++y)
+            sprites.append(m_jobs[next + y].image);
+        br.highlight = sprites.size();
+        for(y = 0; y < br.frames; ++y)
+            sprites.append(m_jobs[next + y].variant);
+        next += br.frames;
+    }
+    m_atlas = std::make_shared<SpriteAtlas>();
+    m_atlas->setSprites(sprites);
+
+    // the resources are swapped on the GUI thread with the atlas ready
+    QMetaObject::invokeMethod(this, &ResourceLoader::promote, Qt::QueuedConnection);
+}
+
+void ResourceLoader::promote()
+{
+    std::shared_ptr<PGlobalResources> res = std::make_shared<PGlobalResources>();
+    PB_TRACE_SCOPE("ResourceLoader::promote");
+    m_decoding = false;
+
+    res->gameLogo = m_jobs[ImageLogo].image;
+    res->uiTopHeader = m_jobs[ImageTopHeader].image;
+    res->background = m_jobs[ImageBackground].image;
+    res->cursor = m_jobs[ImageCursor].image;
+    res->gridBackgroundBorder = m_jobs[ImageGridBorder].image;
+    res->gridBackground = m_jobs[ImageGridBackground].image;
+    res->gridBackgroundBg = m_jobs[ImageGridBackgroundBg].image;
+    res->gridCell = m_jobs[ImageGridCell].image;
+    res->gridCellBright = m_jobs[ImageGridCell].variant;
+    res->BlockRes = std::make_shared<QList<BlockResource>>(m_blocks);
+    res->atlas = std::move(m_atlas);
+
+    // the static layer is drawn once per size, from images it can be drawn on any thread
+    res->staticSources = std::make_shared<StaticSources>();
+    res->staticSources->window = QBrush(m_jobs[ImageBackground].image);
+    res->staticSources->logo = m_jobs[ImageLogo].image;
+    res->staticSources->gridBorder = m_jobs[ImageGridBorder].image;
+    res->staticSources->gridBackground = m_jobs[ImageGridBackground].image;
+    res->staticSources->gridBackgroundBg = m_jobs[ImageGridBackgroundBg].image;
+    res->storage = m_storage;
+    clearJobs();
+
+    // the sounds are the same for every pack
+    if(m_resources != nullptr)
+    {
+        res->soundManager = m_resources->soundManager;
+        m_resources = std::move(res);
+        emit ready();
+        return;
+    }
+
+    // Sounds, QSoundEffect decodes them on its own threads
+    res->soundManager = std::make_shared<SoundManager>(nullptr);
+    res->soundManager->setPoolSize(24);
+    res->soundManager->registerSound("block-hits", QUrl::fromLocalFile(":/pixelblastgame/block-hits"), false);
+
+    res->soundManager->registerSound("block-click0", QUrl::fromLocalFile(":/pixelblastgame/block-click0"));
+    res->soundManager->registerSound("block-click1", QUrl::fromLocalFile(":/pixelblastgame/block-click1"));
+    res->soundManager->registerSound("block-click2", QUrl::fromLocalFile(":/pixelblastgame/block-click2"));
+
+    res->soundManager->registerSound("block-place0", QUrl::fromLocalFile(":/pixelblastgame/block-place0"));
+    res->soundManager->registerSound("block-place1", QUrl::fromLocalFile(":/pixelblastgame/block-place1"));
+    res->soundManager->registerSound("block-place2", QUrl::fromLocalFile(":/pixelblastgame/block-place2"));
+
+    res->soundManager->registerSound("voice0", QUrl::fromLocalFile(":/pixelblastgame/voice0"));
+    res->soundManager->registerSound("voice1", QUrl::fromLocalFile(":/pixelblastgame/voice1"));
+    res->soundManager->registerSound("voice2", QUrl::fromLocalFile(":/pixelblastgame/voice2"));
+    res->soundManager->registerSound("voice3", QUrl::fromLocalFile(":/pixelblastgame/voice3"));
+    res->soundManager->registerSound("voice-gameover", QUrl::fromLocalFile(":/pixelblastgame/voice-gameover"));
+
+    res->soundManager->registerSound("block-destroy", QUrl::fromLocalFile(":/pixelblastgame/block-destroy"));
+
+    m_resources = std::move(res);
+    PB_TRACE_END("resources", this);
+    emit ready();
+}
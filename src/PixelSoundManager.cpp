@@ -1,6 +1,7 @@
 #include <QAudioDevice>
 
 #include "PixelSoundManager.h"
+#include "PixelTrace.h"
 
 SoundManager::SoundManager(QObject *parent) : QObject(parent), m_minIndex(0)
 {
@@ -49,6 +50,7 @@ void SoundManager::registerSound(const QString &name, const QUrl &url, bool asPo
 void SoundManager::playSound(const QString &name, qreal volume)
 {
     int x, y;
+    PB_TRACE_SCOPE("SoundManager::playSound");
     if(!m_registry.contains(name))
         return;
     ensurePool();
@@ -0,0 +1,123 @@
+#include <QtMath>
+
+#include "PixelSpriteAtlas.h"
+
+SpriteAtlas::SpriteAtlas(bool images) : m_images(images)
+{
+}
+
+void SpriteAtlas::setSprites(const QList<QImage> &sprites)
+{
+    int x;
+    m_count = sprites.size();
+    m_slot = 1;
+    for(const QImage &sprite : sprites)
+        m_slot = qMax(m_slot, qMax(sprite.width(), sprite.height()));
+    m_columns = qMax(1, qCeil(qSqrt(m_count)));
+    m_rows = qMax(1, (m_count + m_columns - 1) / m_columns);
+
+    m_source = QImage(m_columns * m_slot, m_rows * m_slot, QImage::Format_ARGB32_Premultiplied);
+    m_source.fill(Qt::transparent);
+    QPainter p(&m_source);
+    p.setRenderHint(QPainter::SmoothPixmapTransform);
+    for(x = 0; x < m_count; ++x)
+        p.drawImage(QRect((x % m_columns) * m_slot, (x / m_columns) * m_slot, m_slot, m_slot), sprites[x]);
+    p.end();
+    clear();
+}
+
+void SpriteAtlas::setSprites(const SpriteAtlas &other)
+{
+    m_source = other.m_source;
+    m_slot = other.m_slot;
+    m_columns = other.m_columns;
+    m_rows = other.m_rows;
+    m_count = other.m_count;
+    clear();
+}
+
+void SpriteAtlas::setDevicePixelRatio(qreal ratio)
+{
+    if(qFuzzyCompare(m_ratio, ratio))
+        return;
+    m_ratio = ratio;
+    clear();
+}
+
+void SpriteAtlas::clear()
+{
+    m_scaled.clear();
+    m_scaledImages.clear();
+}
+
+QImage SpriteAtlas::scaledImage(int size) const
+{
+    int x, pixels;
+    // every slot is scaled on its own, neighbours do not bleed into the edges
+    pixels = qMax(1, qRound(size * m_ratio));
+    QImage atlas(m_columns * pixels, m_rows * pixels, QImage::Format_ARGB32_Premultiplied);
+    atlas.fill(Qt::transparent);
+    QPainter p(&atlas);
+    p.setRenderHint(QPainter::SmoothPixmapTransform);
+    for(x = 0; x < m_count; ++x)
+        p.drawImage(QRect((x % m_columns) * pixels, (x / m_columns) * pixels, pixels, pixels), m_source, QRect((x % m_columns) * m_slot, (x / m_columns) * m_slot, m_slot, m_slot));
+    p.end();
+    return atlas;
+}
+
+const QPixmap &SpriteAtlas::scaled(int size)
+{
+    auto it = m_scaled.constFind(size);
+    if(it != m_scaled.cend())
+        return *it;
+    return *m_scaled.insert(size, QPixmap::fromImage(scaledImage(size)));
+}
+
+const QImage &SpriteAtlas::scaledAsImage(int size)
+{
+    auto it = m_scaledImages.constFind(size);
+    if(it != m_scaledImages.cend())
+        return *it;
+    return *m_scaledImages.insert(size, scaledImage(size));
+}
+
+void SpriteAtlas::begin(int size)
+{
+    m_size = qMax(1, size);
+    m_pixels = qMax(1, qRound(m_size * m_ratio));
+    m_fragmentCount = 0;
+}
+
+void SpriteAtlas::add(int sprite, QPoint topLeft, qreal opacity)
+{
+    if(m_fragmentCount == MaxFragments || sprite < 0 || sprite >= m_count)
+        return;
+    // fragments are placed by their centers, the scale takes the device pixels back to the widget ones
+    m_fragments[m_fragmentCount++] = QPainter::PixmapFragment::create(QPointF(topLeft) + QPointF(m_size / 2.0, m_size / 2.0),
+                                                                      QRectF((sprite % m_columns) * m_pixels, (sprite / m_columns) * m_pixels, m_pixels, m_pixels), 1 / m_ratio, 1 / m_ratio, 0, opacity);
+}
+
+void SpriteAtlas::draw(QPainter &painter)
+{
+    int x;
+    qreal opacity;
+    if(m_fragmentCount > 0 && !m_images)
+    {
+        painter.drawPixmapFragments(m_fragments.data(), m_fragmentCount, scaled(m_size));
+    }
+    else if(m_fragmentCount > 0)
+    {
+        // the same fragments one by one, the opacity changes only between the layers of a frame
+        const QImage &atlas = scaledAsImage(m_size);
+        opacity = painter.opacity();
+        for(x = 0; x < m_fragmentCount; ++x)
+        {
+            const QPainter::PixmapFragment &f = m_fragments[x];
+            if(f.opacity != painter.opacity())
+                painter.setOpacity(f.opacity);
+            painter.drawImage(QRectF(f.x - m_size / 2.0, f.y - m_size / 2.0, m_size, m_size), atlas, QRectF(f.sourceLeft, f.sourceTop, f.width, f.height));
+        }
+        painter.setOpacity(opacity);
+    }
+    m_fragmentCount = 0;
+}
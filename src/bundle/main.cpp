@@ -0,0 +1,194 @@
+#include <cstdio>
+
+#include <QByteArray>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QImage>
+#include <QSet>
+#include <QTextStream>
+#include <QXmlStreamReader>
+
+#include "PixelBundle.h"
+#include "PixelImageFilter.h"
+
+/*
+    pixelblast_bundle SPRITES.qrc OUTPUT [SOURCE]
+
+    Decodes every PNG of the qrc into a sprite bundle (PixelBundle.h) for the resource loader.
+    The frames of every block of blocks.cfg come first, each block followed by its highlighted
+    frames, then the other images under their aliases, the grid cell with its brightness and
+    the bright grid cell after it. Run by the build, see src/CMakeLists.txt; run over the qrc
+    of a theme it makes a resource pack, see PixelResourceLoader.h. With SOURCE it also writes
+    the bundle as a C++ array on a BundleAlign boundary, the build links it into the game.
+*/
+
+struct QrcFile
+{
+    QString name;
+    QString path;
+};
+
+static bool readQrc(const QString &path, QList<QrcFile> &files)
+{
+    QFile file(path);
+    QString alias, source;
+    QXmlStreamReader xml;
+    if(!file.open(QFile::ReadOnly))
+        return false;
+    xml.setDevice(&file);
+    while(!xml.atEnd())
+    {
+        if(xml.readNext() != QXmlStreamReader::StartElement || xml.name() != QLatin1String("file"))
+            continue;
+        alias = xml.attributes().value("alias").toString();
+        source = xml.readElementText().trimmed();
+        files.append({alias.isEmpty() ? source : alias, QFileInfo(path).dir().filePath(source)});
+    }
+    return !xml.hasError();
+}
+
+static bool loadImage(const QString &path, QImage &image)
+{
+    if(!image.load(path))
+    {
+        std::fprintf(stderr, "pixelblast_bundle: can not decode %s\n", qPrintable(path));
+        return false;
+    }
+    image = std::move(image).convertToFormat(QImage::Format_ARGB32_Premultiplied);
+    return true;
+}
+
+static void filterImage(QImage &image, const ImageFilter &filter)
+{
+    int y;
+    for(y = 0; y < image.height(); ++y)
+        filter.apply(reinterpret_cast<std::uint32_t *>(image.scanLine(y)), image.width());
+}
+
+static int addImage(BundleWriter &writer, const QString &name, const QImage &image)
+{
+    return writer.addImage(name.toStdString(), image.width(), image.height(), reinterpret_cast<const std::uint32_t *>(image.constBits()), static_cast<int>(image.bytesPerLine()));
+}
+
+// The bundle at path as the definition of PixelBundleData and PixelBundleSize
+static bool writeSource(const char *path, const char *source)
+{
+    int x;
+    bool ok;
+    QByteArray data;
+    QFile bundle(QString::fromLocal8Bit(path));
+    std::FILE *file;
+    if(!bundle.open(QFile::ReadOnly))
+        return false;
+    data = bundle.readAll();
+    file = std::fopen(source, "wb");
+    if(file == nullptr)
+        return false;
+    std::fprintf(file, "// Generated by pixelblast_bundle from %s\n#include <cstddef>\n\n", path);
+    std::fprintf(file, "extern const std::size_t PixelBundleSize = %lld;\n", static_cast<long long>(data.size()));
+    std::fprintf(file, "alignas(%d) extern const unsigned char PixelBundleData[] = {", static_cast<int>(BundleAlign));
+    for(x = 0; x < data.size(); ++x)
+        std::fprintf(file, x % 16 == 0 ? "\n    0x%02x," : "0x%02x,", static_cast<unsigned char>(data[x]));
+    std::fprintf(file, "\n};\n");
+    ok = std::ferror(file) == 0;
+    return std::fclose(file) == 0 && ok;
+}
+
+int main(int argc, char *argv[])
+{
+    int x, first, highlight, frames;
+    QString line, framePath;
+    QStringList fields;
+    QImage image;
+    QList<QrcFile> files;
+    QHash<QString, QString> paths;
+    QSet<QString> bundled;
+    QList<QImage> images;
+    ImageFilter highlightFilter, cellFilter, brightFilter;
+    BundleWriter writer;
+
+    if(argc != 3 && argc != 4)
+    {
+        std::fprintf(stderr, "usage: pixelblast_bundle SPRITES.qrc OUTPUT [SOURCE]\n");
+        return 2;
+    }
+    if(!readQrc(QString::fromLocal8Bit(argv[1]), files))
+    {
+        std::fprintf(stderr, "pixelblast_bundle: can not read %s\n", argv[1]);
+        return 1;
+    }
+    for(const QrcFile &file : files)
+        paths.insert(file.name, file.path);
+
+    highlightFilter.brightness(HighlightBrightness);
+    cellFilter.brightness(GridCellBrightness);
+    brightFilter.brightness(GridCellBrightBrightness);
+
+    // lines of "name frames pattern", # of the pattern is the frame number from 1
+    QFile config(paths.value("resourcepacks/blocks/blocks.cfg"));
+    if(!config.open(QFile::ReadOnly | QFile::Text))
+    {
+        std::fprintf(stderr, "pixelblast_bundle: no blocks.cfg in %s\n", argv[1]);
+        return 1;
+    }
+    QTextStream stream(&config);
+    while(stream.readLineInto(&line))
+    {
+        fields = line.split(' ', Qt::SkipEmptyParts);
+        if(fields.size() != 3 || (frames = fields[1].toInt()) < 1)
+        {
+            std::fprintf(stderr, "pixelblast_bundle: bad line of blocks.cfg: %s\n", qPrintable(line));
+            return 1;
+        }
+        images.clear();
+        for(x = 0; x < frames; ++x)
+        {
+            framePath = "resourcepacks/blocks/" + QString(fields[2]).replace('#', QString::number(x + 1));
+            bundled.insert(framePath);
+            if(!loadImage(paths.value(framePath), image))
+                return 1;
+            images.append(image);
+        }
+        first = writer.imageCount();
+        for(x = 0; x < frames; ++x)
+            addImage(writer, fields[0] + QString("/%1").arg(x + 1), images[x]);
+        highlight = writer.imageCount();
+        for(x = 0; x < frames; ++x)
+        {
+            filterImage(images[x], highlightFilter);
+            addImage(writer, fields[0] + QString("/%1/highlight").arg(x + 1), images[x]);
+        }
+        writer.addBlock(fields[0].toStdString(), frames, first, highlight);
+    }
+
+    for(const QrcFile &file : files)
+    {
+        if(!file.path.endsWith(".png") || bundled.contains(file.name))
+            continue;
+        if(!loadImage(file.path, image))
+            return 1;
+        if(file.name == "grid-cell")
+        {
+            filterImage(image, cellFilter);
+            addImage(writer, file.name, image);
+            filterImage(image, brightFilter);
+            addImage(writer, BundleGridCellBright, image);
+            continue;
+        }
+        addImage(writer, file.name, image);
+    }
+
+    if(!writer.write(argv[2]))
+    {
+        std::fprintf(stderr, "pixelblast_bundle: can not write %s\n", argv[2]);
+        return 1;
+    }
+    if(argc == 4 && !writeSource(argv[2], argv[3]))
+    {
+        std::fprintf(stderr, "pixelblast_bundle: can not write %s\n", argv[3]);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,204 @@
+#include <atomic>
+#include <cerrno>
+#include <cstdlib>
+#include <new>
+
+#include "PixelAllocTrace.h"
+
+#ifdef PB_ALLOC_TRACE
+
+static std::atomic<std::uint64_t> allocations {0};
+
+#ifdef __GLIBC__
+
+// The allocator of glibc under the names it keeps for wrappers like these
+extern "C" void *__libc_malloc(std::size_t size);
+extern "C" void *__libc_calloc(std::size_t count, std::size_t size);
+extern "C" void *__libc_realloc(void *ptr, std::size_t size);
+extern "C" void *__libc_memalign(std::size_t alignment, std::size_t size);
+
+// Every malloc of the process: operator new of libstdc++ and the QArrayData of QString,
+// QList and QByteArray come through here. free is left to glibc
+extern "C" void *malloc(std::size_t size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_malloc(size);
+}
+
+extern "C" void *calloc(std::size_t count, std::size_t size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_calloc(count, size);
+}
+
+extern "C" void *realloc(void *ptr, std::size_t size)
+{
+    // a shrink or a free is not an allocation, a growth may move the block
+    if(size != 0)
+        allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_realloc(ptr, size);
+}
+
+extern "C" void *memalign(std::size_t alignment, std::size_t size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_memalign(alignment, size);
+}
+
+extern "C" void *aligned_alloc(std::size_t alignment, std::size_t size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_memalign(alignment, size);
+}
+
+extern "C" int posix_memalign(void **ptr, std::size_t alignment, std::size_t size)
+{
+    void *out;
+    if(alignment % sizeof(void *) != 0 || (alignment & (alignment - 1)) != 0)
+        return EINVAL;
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if((out = __libc_memalign(alignment, size)) == nullptr)
+        return ENOMEM;
+    *ptr = out;
+    return 0;
+}
+
+#else
+
+static void *countedAlloc(std::size_t size)
+{
+    void *ptr;
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    while((ptr = std::malloc(size == 0 ? 1 : size)) == nullptr)
+    {
+        std::new_handler handler = std::get_new_handler();
+        if(handler == nullptr)
+            throw std::bad_alloc();
+        handler();
+    }
+    return ptr;
+}
+
+static void *countedAlignedAlloc(std::size_t size, std::align_val_t align)
+{
+    void *ptr;
+    std::size_t alignment = static_cast<std::size_t>(align);
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    // aligned_alloc wants the size rounded to the alignment
+    size = (size + alignment - 1) / alignment * alignment;
+#ifdef _WIN32
+    ptr = _aligned_malloc(size == 0 ? alignment : size, alignment);
+#else
+    ptr = std::aligned_alloc(alignment, size == 0 ? alignment : size);
+#endif
+    if(ptr == nullptr)
+        throw std::bad_alloc();
+    return ptr;
+}
+
+static void alignedFree(void *ptr)
+{
+#ifdef _WIN32
+    _aligned_free(ptr);
+#else
+    std::free(ptr);
+#endif
+}
+
+void *operator new(std::size_t size)
+{
+    return countedAlloc(size);
+}
+
+void *operator new[](std::size_t size)
+{
+    return countedAlloc(size);
+}
+
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    return std::malloc(size == 0 ? 1 : size);
+}
+
+void *operator new[](std::size_t size, const std::nothrow_t &) noexcept
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    return std::malloc(size == 0 ? 1 : size);
+}
+
+void *operator new(std::size_t size, std::align_val_t align)
+{
+    return countedAlignedAlloc(size, align);
+}
+
+void *operator new[](std::size_t size, std::align_val_t align)
+{
+    return countedAlignedAlloc(size, align);
+}
+
+void operator delete(void *ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete[](void *ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete(void *ptr, std::size_t) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete[](void *ptr, std::size_t) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete(void *ptr, std::align_val_t) noexcept
+{
+    alignedFree(ptr);
+}
+
+void operator delete[](void *ptr, std::align_val_t) noexcept
+{
+    alignedFree(ptr);
+}
+
+void operator delete(void *ptr, std::size_t, std::align_val_t) noexcept
+{
+    alignedFree(ptr);
+}
+
+void operator delete[](void *ptr, std::size_t, std::align_val_t) noexcept
+{
+    alignedFree(ptr);
+}
+
+#endif
+
+bool allocationTraceEnabled()
+{
+    return true;
+}
+
+std::uint64_t allocationCount()
+{
+    return allocations.load(std::memory_order_relaxed);
+}
+
+#else
+
+bool allocationTraceEnabled()
+{
+    return false;
+}
+
+std::uint64_t allocationCount()
+{
+    return 0;
+}
+
+#endif
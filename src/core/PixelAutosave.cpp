@@ -0,0 +1,90 @@
+#include <cstring>
+#include <type_traits>
+
+#include "PixelAutosave.h"
+
+static_assert(std::is_trivially_copyable_v<GameSnapshot> && sizeof(GameSnapshot) == 64);
+
+static std::uint32_t slotChecksum(const std::uint8_t *slot)
+{
+    int x;
+    std::uint32_t hash = 2166136261U;
+    for(x = 0; x < AutosaveSlotSize; ++x)
+    {
+        // the checksum field itself is skipped
+        if(x >= 4 && x < 8)
+            continue;
+        hash = (hash ^ slot[x]) * 16777619U;
+    }
+    return hash;
+}
+
+static std::uint32_t readWord(const std::uint8_t *data)
+{
+    return data[0] | data[1] << 8 | data[2] << 16 | static_cast<std::uint32_t>(data[3]) << 24;
+}
+
+static void writeWord(std::uint8_t *out, std::uint32_t value)
+{
+    int x;
+    for(x = 0; x < 4; ++x)
+        out[x] = static_cast<std::uint8_t>(value >> (x * 8));
+}
+
+void writeAutosave(std::uint8_t *file, const GameEngine &engine, std::uint32_t sequence)
+{
+    int x;
+    Bitboard cells;
+    GameSnapshot snapshot = engine.snapshot();
+    std::uint8_t *slot = file + (sequence & 0x1) * AutosaveSlotSize;
+
+    writeWord(slot, sequence);
+    encodeReplayHeader(replayHeader(engine), slot + 8);
+    std::memcpy(slot + 28, &snapshot, sizeof(snapshot));
+    for(x = 0, cells = snapshot.occupied; cells.any(); ++x)
+        slot[92 + x] = engine.state().colors[cells.takeFirst()];
+    std::memset(slot + 92 + x, 0, BoardCells - x);
+    writeWord(slot + 4, slotChecksum(slot));
+}
+
+bool readAutosave(const std::uint8_t *file, std::size_t size, Autosave &save)
+{
+    int x;
+    bool found = false;
+    Autosave slotSave;
+    const std::uint8_t *slot;
+    if(size < AutosaveSize)
+        return false;
+    for(x = 0; x < 2; ++x)
+    {
+        slot = file + x * AutosaveSlotSize;
+        if(readWord(slot + 4) != slotChecksum(slot) || !decodeReplayHeader(slot + 8, slotSave.header))
+            continue;
+        slotSave.sequence = readWord(slot);
+        if(found && slotSave.sequence < save.sequence)
+            continue;
+        std::memcpy(&slotSave.snapshot, slot + 28, sizeof(slotSave.snapshot));
+        std::memcpy(slotSave.colors.data(), slot + 92, BoardCells);
+        save = slotSave;
+        found = true;
+    }
+    return found;
+}
+
+bool resumeAutosave(GameEngine &engine, const Autosave &save)
+{
+    int x, count = save.snapshot.occupied.count();
+    if(save.snapshot.width != save.header.width || (save.snapshot.flags & SnapshotOver) != 0)
+        return false;
+    // a color out of the range of the save would index past the block sprites
+    for(x = 0; x < count; ++x)
+    {
+        if(save.colors[x] >= save.header.colorCount)
+            return false;
+    }
+    startReplay(engine, save.header);
+    if(!engine.restore(save.snapshot))
+        return false;
+    engine.recolor(save.snapshot.occupied, save.colors.data());
+    return true;
+}
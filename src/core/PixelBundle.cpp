@@ -0,0 +1,207 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#include "PixelBundle.h"
+
+static std::uint32_t readWord(const std::uint8_t *data)
+{
+    return data[0] | data[1] << 8 | data[2] << 16 | static_cast<std::uint32_t>(data[3]) << 24;
+}
+
+static void writeWord(std::uint8_t *out, std::uint32_t value)
+{
+    out[0] = static_cast<std::uint8_t>(value);
+    out[1] = static_cast<std::uint8_t>(value >> 8);
+    out[2] = static_cast<std::uint8_t>(value >> 16);
+    out[3] = static_cast<std::uint8_t>(value >> 24);
+}
+
+static std::string readName(const std::uint8_t *data)
+{
+    const char *name = reinterpret_cast<const char *>(data);
+    return std::string(name, std::find(name, name + BundleNameSize, '\0'));
+}
+
+static void writeName(std::uint8_t *out, const std::string &name)
+{
+    std::memset(out, 0, BundleNameSize);
+    std::memcpy(out, name.data(), std::min<std::size_t>(name.size(), BundleNameSize - 1));
+}
+
+static std::size_t alignUp(std::size_t value)
+{
+    return (value + BundleAlign - 1) / BundleAlign * BundleAlign;
+}
+
+bool SpriteBundle::open(const std::uint8_t *data, std::size_t size)
+{
+    int x;
+    std::size_t images, blocks, offset;
+    const std::uint8_t *entry;
+
+    clear();
+    if(size < BundleHeaderSize || std::memcmp(data, BundleMagic, sizeof(BundleMagic)) != 0 || readWord(data + 4) != BundleVersion)
+        return false;
+    images = readWord(data + 8);
+    blocks = readWord(data + 12);
+    if(images > (size - BundleHeaderSize) / BundleImageSize || blocks > (size - BundleHeaderSize - images * BundleImageSize) / BundleBlockSize)
+        return false;
+
+    _images.resize(images);
+    for(x = 0; x < static_cast<int>(images); ++x)
+    {
+        BundleImage &image = _images[x];
+        entry = data + BundleHeaderSize + x * BundleImageSize;
+        image.name = readName(entry);
+        image.width = static_cast<int>(readWord(entry + BundleNameSize));
+        image.height = static_cast<int>(readWord(entry + BundleNameSize + 4));
+        image.stride = static_cast<int>(readWord(entry + BundleNameSize + 8));
+        offset = readWord(entry + BundleNameSize + 12);
+        // the size is checked in 64 bits, a stride of a corrupt bundle does not wrap around
+        if(image.width < 0 || image.height < 0 || image.stride < static_cast<std::int64_t>(image.width) * 4 || offset % BundleAlign != 0 || offset > size || static_cast<std::uint64_t>(image.stride) * image.height > size - offset)
+        {
+            clear();
+            return false;
+        }
+        image.pixels = reinterpret_cast<const std::uint32_t *>(data + offset);
+    }
+
+    _blocks.resize(blocks);
+    for(x = 0; x < static_cast<int>(blocks); ++x)
+    {
+        BundleBlock &block = _blocks[x];
+        entry = data + BundleHeaderSize + images * BundleImageSize + x * BundleBlockSize;
+        block.name = readName(entry);
+        block.frames = static_cast<int>(readWord(entry + BundleNameSize));
+        block.image = static_cast<int>(readWord(entry + BundleNameSize + 4));
+        block.highlight = static_cast<int>(readWord(entry + BundleNameSize + 8));
+        if(block.frames < 1 || block.image < 0 || block.highlight < 0 || block.image + block.frames > static_cast<int>(images) || block.highlight + block.frames > static_cast<int>(images))
+        {
+            clear();
+            return false;
+        }
+    }
+    return true;
+}
+
+void SpriteBundle::clear()
+{
+    _images.clear();
+    _blocks.clear();
+}
+
+int SpriteBundle::imageCount() const
+{
+    return static_cast<int>(_images.size());
+}
+
+const BundleImage &SpriteBundle::image(int index) const
+{
+    return _images[index];
+}
+
+int SpriteBundle::findImage(const std::string &name) const
+{
+    int x;
+    for(x = 0; x < static_cast<int>(_images.size()); ++x)
+        if(_images[x].name == name)
+            return x;
+    return -1;
+}
+
+int SpriteBundle::blockCount() const
+{
+    return static_cast<int>(_blocks.size());
+}
+
+const BundleBlock &SpriteBundle::block(int index) const
+{
+    return _blocks[index];
+}
+
+int BundleWriter::addImage(const std::string &name, int width, int height, const std::uint32_t *pixels, int stride)
+{
+    int y;
+    Entry entry {name, width, height, std::vector<std::uint32_t>(static_cast<std::size_t>(width) * height)};
+    for(y = 0; y < height; ++y)
+        std::memcpy(entry.pixels.data() + static_cast<std::size_t>(y) * width, reinterpret_cast<const std::uint8_t *>(pixels) + static_cast<std::size_t>(y) * stride, static_cast<std::size_t>(width) * 4);
+    _images.push_back(std::move(entry));
+    return static_cast<int>(_images.size()) - 1;
+}
+
+void BundleWriter::addBlock(const std::string &name, int frames, int image, int highlight)
+{
+    _blocks.push_back({name, frames, image, highlight});
+}
+
+int BundleWriter::imageCount() const
+{
+    return static_cast<int>(_images.size());
+}
+
+bool BundleWriter::write(const char *path) const
+{
+    int x;
+    bool ok;
+    std::size_t offset;
+    std::uint8_t *entry;
+    std::string temp;
+    std::vector<std::uint8_t> tables(BundleHeaderSize + _images.size() * BundleImageSize + _blocks.size() * BundleBlockSize);
+    std::FILE *file;
+
+    std::memcpy(tables.data(), BundleMagic, sizeof(BundleMagic));
+    writeWord(tables.data() + 4, BundleVersion);
+    writeWord(tables.data() + 8, static_cast<std::uint32_t>(_images.size()));
+    writeWord(tables.data() + 12, static_cast<std::uint32_t>(_blocks.size()));
+
+    offset = alignUp(tables.size());
+    for(x = 0; x < static_cast<int>(_images.size()); ++x)
+    {
+        entry = tables.data() + BundleHeaderSize + x * BundleImageSize;
+        writeName(entry, _images[x].name);
+        writeWord(entry + BundleNameSize, static_cast<std::uint32_t>(_images[x].width));
+        writeWord(entry + BundleNameSize + 4, static_cast<std::uint32_t>(_images[x].height));
+        writeWord(entry + BundleNameSize + 8, static_cast<std::uint32_t>(_images[x].width * 4));
+        writeWord(entry + BundleNameSize + 12, static_cast<std::uint32_t>(offset));
+        offset = alignUp(offset + _images[x].pixels.size() * 4);
+    }
+    for(x = 0; x < static_cast<int>(_blocks.size()); ++x)
+    {
+        entry = tables.data() + BundleHeaderSize + _images.size() * BundleImageSize + x * BundleBlockSize;
+        writeName(entry, _blocks[x].name);
+        writeWord(entry + BundleNameSize, static_cast<std::uint32_t>(_blocks[x].frames));
+        writeWord(entry + BundleNameSize + 4, static_cast<std::uint32_t>(_blocks[x].image));
+        writeWord(entry + BundleNameSize + 8, static_cast<std::uint32_t>(_blocks[x].highlight));
+    }
+
+    // written next to the path and renamed over it: a game that maps the old file keeps reading it
+    temp = std::string(path) + ".tmp";
+    file = std::fopen(temp.c_str(), "wb");
+    if(file == nullptr)
+        return false;
+    std::fwrite(tables.data(), 1, tables.size(), file);
+    offset = tables.size();
+    for(const Entry &image : _images)
+    {
+        // zero padding up to the next boundary
+        for(; offset % BundleAlign != 0; ++offset)
+            std::fputc(0, file);
+        // the pixels are words of the host, little-endian like the tables on every target of the game
+        std::fwrite(image.pixels.data(), 4, image.pixels.size(), file);
+        offset += image.pixels.size() * 4;
+    }
+    ok = std::ferror(file) == 0;
+    if(std::fclose(file) != 0 || !ok)
+    {
+        std::remove(temp.c_str());
+        return false;
+    }
+    // rename does not replace a file on Windows
+    if(std::rename(temp.c_str(), path) != 0 && (std::remove(path) != 0 || std::rename(temp.c_str(), path) != 0))
+    {
+        std::remove(temp.c_str());
+        return false;
+    }
+    return true;
+}
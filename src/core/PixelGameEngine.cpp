@@ -0,0 +1,523 @@
+#include <algorithm>
+#include <limits>
+#include <random>
+
+#include "PixelGameEngine.h"
+#include "PixelTrace.h"
+
+// Triplets sampled before the exhaustive search, and placements searched for every triplet
+constexpr int SelectiveTries = 8;
+constexpr int SelectiveBudget = 256;
+
+GameEngine::GameEngine(CandidateMode mode, int width) : _mode(mode), _width(DefaultBoardWidth), _colorCount(DefaultColorCount), _rotation(false), _difficulty(0), _weights(), _weightSums(), _seed(0), _nextSeed(0), _state(), _random()
+{
+    std::random_device device;
+    _nextSeed = mixSeed(static_cast<std::uint64_t>(device()) << 32 | device());
+    setBoardWidth(width);
+    setDifficulty(0);
+    reset();
+}
+
+void GameEngine::reset()
+{
+    _seed = _nextSeed;
+    _nextSeed = mixSeed(_seed);
+    _random.seed(_seed);
+    _state = {};
+    _state.width = _width;
+    _state.rotation = _rotation;
+    _state.round = 1;
+    generateCandidates();
+    _state.over = checkOver();
+}
+
+void GameEngine::setSeed(std::uint64_t seed)
+{
+    _nextSeed = seed;
+}
+
+std::uint64_t GameEngine::seed() const
+{
+    return _seed;
+}
+
+void GameEngine::setBoardWidth(int width)
+{
+    _width = std::clamp(width, MinBoardWidth, MaxBoardWidth);
+}
+
+int GameEngine::boardWidth() const
+{
+    return _width;
+}
+
+void GameEngine::setColorCount(int count)
+{
+    _colorCount = std::max(1, count);
+}
+
+int GameEngine::colorCount() const
+{
+    return _colorCount;
+}
+
+void GameEngine::setCandidateMode(CandidateMode mode)
+{
+    _mode = mode;
+}
+
+CandidateMode GameEngine::candidateMode() const
+{
+    return _mode;
+}
+
+void GameEngine::setRotation(bool rotation)
+{
+    _rotation = rotation;
+}
+
+bool GameEngine::rotation() const
+{
+    return _rotation;
+}
+
+int GameEngine::orientationCount(int shape, bool rotation)
+{
+    return rotation ? getShape(shape).orientations : 1;
+}
+
+void GameEngine::setCandidateWeights(const CandidateWeights &weights)
+{
+    int x, sum = 0;
+    _weights = weights;
+    for(x = 0; x < MaxShapes; ++x)
+    {
+        sum += std::max(0, _weights.shapes[x]);
+        _weightSums[x] = sum;
+    }
+    // all zero weights fall back to the uniform pick
+    if(sum == 0)
+        setCandidateWeights(makeCandidateWeights(0));
+}
+
+const CandidateWeights &GameEngine::candidateWeights() const
+{
+    return _weights;
+}
+
+void GameEngine::setDifficulty(int difficulty)
+{
+    _difficulty = std::clamp(difficulty, -100, 100);
+    setCandidateWeights(makeCandidateWeights(_difficulty));
+}
+
+int GameEngine::difficulty() const
+{
+    return _difficulty;
+}
+
+int GameEngine::sampleShape()
+{
+    int pick = static_cast<int>(_random.bounded(_weightSums.back()));
+    return static_cast<int>(std::upper_bound(std::begin(_weightSums), std::end(_weightSums), pick) - std::begin(_weightSums));
+}
+
+Bitboard GameEngine::placementMask(int shape, int cell, int width)
+{
+    int x, y;
+    if(shape < 0 || shape >= ShapeCount || cell < 0 || cell >= BoardCells)
+        return {};
+    const ShapeInfo &info = getShape(shape);
+    x = cell % BoardStride;
+    y = cell / BoardStride;
+    if(x > width - info.columns || y > width - info.rows)
+        return {};
+    return info.placements[cell];
+}
+
+bool GameEngine::canTrigger(int shape, const Bitboard &grids, int width)
+{
+    Bitboard tmp = grids;
+    return placeFirst(shape, tmp, width);
+}
+
+bool GameEngine::placeFirst(int shape, Bitboard &grids, int width)
+{
+    int x, y;
+    const ShapeInfo &info = getShape(shape);
+    for(x = 0; x <= width - info.columns; ++x)
+    {
+        for(y = 0; y <= width - info.rows; ++y)
+        {
+            const Bitboard &placement = info.placements[y * BoardStride + x];
+            if(!grids.intersects(placement))
+            {
+                grids |= placement;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+bool GameEngine::placeAll(const Bitboard &grids, const std::array<int, MaxCandidates> &shapes, unsigned remaining, int width, bool rotation, int &budget)
+{
+    int x, y, z, r, lines;
+    Bitboard next;
+    if(remaining == 0)
+        return true;
+    for(z = 0; z < MaxCandidates; ++z)
+    {
+        if(!(remaining & (1U << z)))
+            continue;
+        for(r = 0; r < orientationCount(shapes[z], rotation); ++r)
+        {
+            const ShapeInfo &info = getShape(rotateShape(shapes[z], r));
+            for(x = 0; x <= width - info.columns; ++x)
+            {
+                for(y = 0; y <= width - info.rows; ++y)
+                {
+                    const Bitboard &placement = info.placements[y * BoardStride + x];
+                    if(grids.intersects(placement))
+                        continue;
+                    if(--budget < 0)
+                        return false;
+                    next = grids | placement;
+                    clearLines(next, width, lines);
+                    if(placeAll(next, shapes, remaining & ~(1U << z), width, rotation, budget))
+                        return true;
+                }
+            }
+        }
+    }
+    return false;
+}
+
+Bitboard GameEngine::clearLines(Bitboard &grids, int width, int &lines)
+{
+    int x;
+    Bitboard line, cleared;
+    lines = 0;
+    for(x = 0; x < width; ++x)
+    {
+        line = bitRow(x, width);
+        if((grids & line) == line)
+        {
+            cleared |= line;
+            ++lines;
+        }
+        line = bitColumn(x, width);
+        if((grids & line) == line)
+        {
+            cleared |= line;
+            ++lines;
+        }
+    }
+    grids &= ~cleared;
+    return cleared;
+}
+
+bool GameEngine::isLegal(const Move &move) const
+{
+    Bitboard mask;
+    if(_state.over || move.candidate < 0 || move.candidate >= MaxCandidates || _state.candidates[move.candidate].shape == -1)
+        return false;
+    if(move.rotation < 0 || move.rotation >= orientationCount(_state.candidates[move.candidate].shape, _state.rotation))
+        return false;
+    mask = placementMask(rotateShape(_state.candidates[move.candidate].shape, move.rotation), move.cell, _state.width);
+    return mask.any() && !_state.occupied.intersects(mask);
+}
+
+void GameEngine::legalMoves(MoveList &list) const
+{
+    int x, y, z, r;
+    list.count = 0;
+    if(_state.over)
+        return;
+    for(z = 0; z < MaxCandidates; ++z)
+    {
+        if(_state.candidates[z].shape == -1)
+            continue;
+        for(r = 0; r < orientationCount(_state.candidates[z].shape, _state.rotation); ++r)
+        {
+            const ShapeInfo &info = getShape(rotateShape(_state.candidates[z].shape, r));
+            for(x = 0; x <= _state.width - info.columns; ++x)
+            {
+                for(y = 0; y <= _state.width - info.rows; ++y)
+                {
+                    if(!_state.occupied.intersects(info.placements[y * BoardStride + x]))
+                        list.moves[list.count++] = {z, y * BoardStride + x, r};
+                }
+            }
+        }
+    }
+}
+
+bool GameEngine::hasLegalMove() const
+{
+    return !checkOver();
+}
+
+void GameEngine::fillCells(Bitboard cells, int color)
+{
+    int z;
+    _state.occupied |= cells;
+    while(cells.any())
+    {
+        z = cells.takeFirst();
+        _state.colors[z] = static_cast<std::uint8_t>(color);
+        ++_state.rowFill[z / BoardStride];
+        ++_state.columnFill[z % BoardStride];
+    }
+}
+
+void GameEngine::removeCells(Bitboard cells)
+{
+    int z;
+    _state.occupied &= ~cells;
+    while(cells.any())
+    {
+        z = cells.takeFirst();
+        --_state.rowFill[z / BoardStride];
+        --_state.columnFill[z % BoardStride];
+    }
+}
+
+GameSnapshot GameEngine::snapshot() const
+{
+    int x;
+    GameSnapshot snapshot {};
+    snapshot.occupied = _state.occupied;
+    snapshot.random = _random.state();
+    snapshot.seed = _seed;
+    snapshot.scores = _state.scores;
+    snapshot.round = static_cast<std::uint32_t>(_state.round);
+    for(x = 0; x < MaxCandidates; ++x)
+    {
+        snapshot.shapes[x] = static_cast<std::int8_t>(_state.candidates[x].shape);
+        snapshot.colors[x] = static_cast<std::uint8_t>(_state.candidates[x].color);
+    }
+    snapshot.width = static_cast<std::uint8_t>(_state.width);
+    snapshot.flags = (_state.over ? SnapshotOver : 0) | (_state.rotation ? SnapshotRotation : 0);
+    return snapshot;
+}
+
+bool GameEngine::restore(const GameSnapshot &snapshot)
+{
+    int x, z;
+    Bitboard cells;
+    if(snapshot.width < MinBoardWidth || snapshot.width > MaxBoardWidth || snapshot.occupied.intersects(~bitBoard(snapshot.width)))
+        return false;
+    for(x = 0; x < MaxCandidates; ++x)
+    {
+        if(snapshot.shapes[x] < -1 || snapshot.shapes[x] >= MaxShapes)
+            return false;
+        if(snapshot.shapes[x] != -1 && snapshot.colors[x] >= _colorCount)
+            return false;
+    }
+
+    _seed = snapshot.seed;
+    _nextSeed = mixSeed(_seed);
+    _random.setState(snapshot.random);
+    _state.width = snapshot.width;
+    _state.occupied = snapshot.occupied;
+    _state.scores = snapshot.scores;
+    _state.round = static_cast<int>(snapshot.round);
+    _state.over = (snapshot.flags & SnapshotOver) != 0;
+    _state.rotation = (snapshot.flags & SnapshotRotation) != 0;
+    for(x = 0; x < MaxCandidates; ++x)
+        _state.candidates[x] = {snapshot.shapes[x], snapshot.colors[x]};
+    _state.rowFill = {};
+    _state.columnFill = {};
+    for(cells = snapshot.occupied; cells.any();)
+    {
+        z = cells.takeFirst();
+        ++_state.rowFill[z / BoardStride];
+        ++_state.columnFill[z % BoardStride];
+    }
+    return true;
+}
+
+void GameEngine::recolor(Bitboard cells, const std::uint8_t *colors)
+{
+    while(cells.any())
+        _state.colors[cells.takeFirst()] = *colors++;
+}
+
+MoveResult GameEngine::applyMove(const Move &move)
+{
+    int x, y, x0, y0;
+    MoveResult result {};
+
+    if(!isLegal(move))
+        return result;
+
+    Candidate &candidate = _state.candidates[move.candidate];
+    const ShapeInfo &info = getShape(rotateShape(candidate.shape, move.rotation));
+    result.placed = true;
+    result.cells = placementMask(rotateShape(candidate.shape, move.rotation), move.cell, _state.width);
+    fillCells(result.cells, candidate.color);
+    candidate.shape = -1;
+
+    // Only the lines crossing the shape box can be completed by this move
+    x0 = move.cell % BoardStride;
+    y0 = move.cell / BoardStride;
+    for(y = y0; y < y0 + info.rows; ++y)
+    {
+        if(_state.rowFill[y] == _state.width)
+        {
+            result.cleared |= bitRow(y, _state.width);
+            ++result.lines;
+        }
+    }
+    for(x = x0; x < x0 + info.columns; ++x)
+    {
+        if(_state.columnFill[x] == _state.width)
+        {
+            result.cleared |= bitColumn(x, _state.width);
+            ++result.lines;
+        }
+    }
+    // a crossing cell is removed once
+    removeCells(result.cleared);
+
+    // each line gives width points
+    result.points = result.lines * _state.width;
+    _state.scores += result.points;
+
+    if(std::all_of(std::cbegin(_state.candidates), std::cend(_state.candidates), [](const Candidate &c) { return c.shape == -1; }))
+    {
+        ++_state.round;
+        generateCandidates();
+    }
+    _state.over = checkOver();
+    return result;
+}
+
+void GameEngine::generateCandidates()
+{
+    int x, y = 0, z, budget;
+    std::array<int, MaxCandidates> candidates;
+    PB_TRACE_SCOPE("GameEngine::generateCandidates");
+
+    candidates.fill(-1);
+    switch(_mode)
+    {
+        case CandidateMode::Selective:
+        {
+            // weighted triplets until one can be placed in some order, clears included
+            for(x = 0; x < SelectiveTries; ++x)
+            {
+                for(z = 0; z < MaxCandidates; ++z)
+                    candidates[z] = sampleShape();
+                budget = SelectiveBudget;
+                if(placeAll(_state.occupied, candidates, (1U << MaxCandidates) - 1, _state.width, _state.rotation, budget))
+                    break;
+            }
+            // crowded board: every triplet of the pool, the last sampled one stays when none fits
+            if(x == SelectiveTries)
+                sampleFittingTriplet(candidates);
+            break;
+        }
+        case CandidateMode::Random:
+        {
+            for(x = 0; x < MaxCandidates; ++x)
+            {
+                do
+                {
+                    y = static_cast<int>(_random.bounded(MaxShapes));
+                } while(std::any_of(std::begin(candidates), std::end(candidates), [y](const auto i) { return i == y; }));
+                candidates[x] = y;
+            }
+            break;
+        }
+    }
+
+    for(x = 0; x < MaxCandidates; ++x)
+    {
+        _state.candidates[x].shape = candidates[x];
+        _state.candidates[x].color = static_cast<int>(_random.bounded(_colorCount));
+    }
+}
+
+bool GameEngine::sampleFittingTriplet(std::array<int, MaxCandidates> &candidates)
+{
+    int a, b, c, budget;
+    std::uint64_t weight, total = 0, pick;
+    std::array<int, MaxCandidates> triplet;
+    std::array<bool, MaxShapes> placeable {};
+    // fit of the sorted triplet a <= b <= c: 0 unknown, 1 fits, 2 does not
+    std::array<std::uint8_t, MaxShapes * MaxShapes * MaxShapes> fits {};
+
+    for(a = 0; a < MaxShapes; ++a)
+    {
+        for(b = 0; b < orientationCount(a, _state.rotation) && !placeable[a]; ++b)
+            placeable[a] = canTrigger(rotateShape(a, b), _state.occupied, _state.width);
+    }
+
+    // an ordered triplet has the chance of three independent samples, the ones that do not fit are left out
+    auto tripletWeight = [&](int x, int y, int z) -> std::uint64_t {
+        int key;
+        if(!placeable[x] || !placeable[y] || !placeable[z])
+            return 0;
+        triplet = {x, y, z};
+        std::sort(std::begin(triplet), std::end(triplet));
+        key = (triplet[0] * MaxShapes + triplet[1]) * MaxShapes + triplet[2];
+        if(fits[key] == 0)
+        {
+            budget = std::numeric_limits<int>::max();
+            fits[key] = placeAll(_state.occupied, triplet, (1U << MaxCandidates) - 1, _state.width, _state.rotation, budget) ? 1 : 2;
+        }
+        if(fits[key] == 2)
+            return 0;
+        return static_cast<std::uint64_t>(std::max(0, _weights.shapes[x])) * std::max(0, _weights.shapes[y]) * std::max(0, _weights.shapes[z]);
+    };
+
+    for(a = 0; a < MaxShapes; ++a)
+    {
+        for(b = 0; b < MaxShapes; ++b)
+        {
+            for(c = 0; c < MaxShapes; ++c)
+                total += tripletWeight(a, b, c);
+        }
+    }
+    if(total == 0)
+        return false;
+
+    // the total needs more than 32 bits
+    pick = static_cast<std::uint64_t>(_random()) << 32;
+    pick = (pick | _random()) % total;
+    for(a = 0; a < MaxShapes; ++a)
+    {
+        for(b = 0; b < MaxShapes; ++b)
+        {
+            for(c = 0; c < MaxShapes; ++c)
+            {
+                weight = tripletWeight(a, b, c);
+                if(pick < weight)
+                {
+                    candidates = {a, b, c};
+                    return true;
+                }
+                pick -= weight;
+            }
+        }
+    }
+    return false;
+}
+
+bool GameEngine::checkOver() const
+{
+    int x, z;
+    for(z = 0; z < MaxCandidates; ++z)
+    {
+        if(_state.candidates[z].shape == -1)
+            continue;
+        for(x = 0; x < orientationCount(_state.candidates[z].shape, _state.rotation); ++x)
+        {
+            if(canTrigger(rotateShape(_state.candidates[z].shape, x), _state.occupied, _state.width))
+                return false;
+        }
+    }
+    return true;
+}
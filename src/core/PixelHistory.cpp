@@ -0,0 +1,76 @@
+#include "PixelHistory.h"
+
+GameHistory::GameHistory() : _entries(), _first(0), _count(0), _position(0)
+{
+}
+
+void GameHistory::clear()
+{
+    _first = 0;
+    _count = 0;
+    _position = 0;
+}
+
+GameHistory::Entry &GameHistory::entry(int index)
+{
+    return _entries[(_first + index) % HistoryCapacity];
+}
+
+Bitboard GameHistory::placedCells(const Entry &entry)
+{
+    return GameEngine::placementMask(rotateShape(entry.before.shapes[entry.candidate], entry.rotation), entry.cell, entry.before.width);
+}
+
+void GameHistory::record(const GameEngine &engine, const Move &move)
+{
+    int x;
+    Bitboard cells;
+    if(!engine.isLegal(move))
+        return;
+
+    _count = _position;
+    if(_count == HistoryCapacity)
+    {
+        // the oldest move can not be undone any more
+        _first = (_first + 1) % HistoryCapacity;
+        --_count;
+    }
+    Entry &last = entry(_count++);
+    _position = _count;
+
+    last.before = engine.snapshot();
+    last.candidate = static_cast<std::uint8_t>(move.candidate);
+    last.cell = static_cast<std::uint8_t>(move.cell);
+    last.rotation = static_cast<std::uint8_t>(move.rotation);
+    for(x = 0, cells = placedCells(last); cells.any(); ++x)
+        last.colors[x] = engine.state().colors[cells.takeFirst()];
+}
+
+bool GameHistory::canUndo() const
+{
+    return _position > 0;
+}
+
+bool GameHistory::canRedo() const
+{
+    return _position < _count;
+}
+
+bool GameHistory::undo(GameEngine &engine)
+{
+    if(!canUndo())
+        return false;
+    const Entry &last = entry(--_position);
+    engine.restore(last.before);
+    engine.recolor(placedCells(last), last.colors.data());
+    return true;
+}
+
+MoveResult GameHistory::redo(GameEngine &engine)
+{
+    if(!canRedo())
+        return {};
+    const Entry &next = entry(_position++);
+    engine.restore(next.before);
+    return engine.applyMove({next.candidate, next.cell, next.rotation});
+}
@@ -0,0 +1,373 @@
+#include <algorithm>
+#include <cstdlib>
+
+#include "PixelImageFilter.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PB_FILTER_SSE2
+#include <emmintrin.h>
+#endif
+
+#if defined(PB_FILTER_SSE2) && defined(__AVX2__)
+#define PB_FILTER_AVX2
+#include <immintrin.h>
+#endif
+
+// Weights of the gray, blue green red in 1/256
+constexpr int GrayBlue = 29;
+constexpr int GrayGreen = 150;
+constexpr int GrayRed = 77;
+
+// x * y / 255 rounded, for x, y in 0..255
+static inline int mulDiv255(int x, int y)
+{
+    int t = x * y + 128;
+    return (t + (t >> 8)) >> 8;
+}
+
+// Strength 0..255 as the blend factor 0..256
+static inline int blendFactor(int strength)
+{
+    return strength + (strength >> 7);
+}
+
+static void applyScalar(const FilterStep *steps, int count, std::uint32_t *pixels, int size)
+{
+    int x, z, a, f, gray;
+    std::uint32_t px;
+    int c[3], t[3];
+    for(x = 0; x < size; ++x)
+    {
+        px = pixels[x];
+        c[0] = px & 0xFF;
+        c[1] = px >> 8 & 0xFF;
+        c[2] = px >> 16 & 0xFF;
+        a = px >> 24;
+        for(z = 0; z < count; ++z)
+        {
+            const FilterStep &step = steps[z];
+            switch(step.kind)
+            {
+                case FilterKind::Brightness:
+                    f = mulDiv255(a, std::abs(step.amount));
+                    for(int &v : c)
+                        v = step.amount > 0 ? std::min(v + f, a) : std::max(v - f, 0);
+                    continue;
+                case FilterKind::Tint:
+                    t[0] = mulDiv255(a, step.color & 0xFF);
+                    t[1] = mulDiv255(a, step.color >> 8 & 0xFF);
+                    t[2] = mulDiv255(a, step.color >> 16 & 0xFF);
+                    break;
+                default: // desaturate
+                    gray = (c[0] * GrayBlue + c[1] * GrayGreen + c[2] * GrayRed) >> 8;
+                    t[0] = t[1] = t[2] = gray;
+                    break;
+            }
+            f = blendFactor(step.amount);
+            c[0] = (c[0] * (256 - f) + t[0] * f) >> 8;
+            c[1] = (c[1] * (256 - f) + t[1] * f) >> 8;
+            c[2] = (c[2] * (256 - f) + t[2] * f) >> 8;
+        }
+        pixels[x] = static_cast<std::uint32_t>(a) << 24 | static_cast<std::uint32_t>(c[2]) << 16 | static_cast<std::uint32_t>(c[1]) << 8 | static_cast<std::uint32_t>(c[0]);
+    }
+}
+
+#ifdef PB_FILTER_SSE2
+
+/*
+    The vector kernels widen the bytes of the pixels to 16-bit lanes, b g r a per pixel,
+    and run the same integer math as applyScalar. One template serves SSE2 and AVX2: the
+    unpack, shuffle and pack instructions work inside every 128-bit half, so the lane order
+    is the same for both widths.
+*/
+
+struct Sse2
+{
+    using Vector = __m128i;
+    static constexpr int Pixels = 4;
+
+    static Vector load(const std::uint32_t *p)
+    {
+        return _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+    }
+    static void store(std::uint32_t *p, Vector v)
+    {
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(p), v);
+    }
+    static Vector set(int v)
+    {
+        return _mm_set1_epi16(static_cast<short>(v));
+    }
+    static Vector lanes(int b, int g, int r, int a)
+    {
+        return _mm_setr_epi16(b, g, r, a, b, g, r, a);
+    }
+    static Vector unpackLo(Vector v)
+    {
+        return _mm_unpacklo_epi8(v, _mm_setzero_si128());
+    }
+    static Vector unpackHi(Vector v)
+    {
+        return _mm_unpackhi_epi8(v, _mm_setzero_si128());
+    }
+    static Vector pack(Vector lo, Vector hi)
+    {
+        return _mm_packus_epi16(lo, hi);
+    }
+    template <int Order>
+    static Vector shuffle(Vector v)
+    {
+        return _mm_shufflehi_epi16(_mm_shufflelo_epi16(v, Order), Order);
+    }
+    static Vector add(Vector x, Vector y)
+    {
+        return _mm_add_epi16(x, y);
+    }
+    static Vector subs(Vector x, Vector y)
+    {
+        return _mm_subs_epu16(x, y);
+    }
+    static Vector mul(Vector x, Vector y)
+    {
+        return _mm_mullo_epi16(x, y);
+    }
+    static Vector shr8(Vector v)
+    {
+        return _mm_srli_epi16(v, 8);
+    }
+    static Vector min(Vector x, Vector y)
+    {
+        return _mm_min_epi16(x, y);
+    }
+    static Vector bitAnd(Vector x, Vector y)
+    {
+        return _mm_and_si128(x, y);
+    }
+    static Vector bitOr(Vector x, Vector y)
+    {
+        return _mm_or_si128(x, y);
+    }
+};
+
+#ifdef PB_FILTER_AVX2
+struct Avx2
+{
+    using Vector = __m256i;
+    static constexpr int Pixels = 8;
+
+    static Vector load(const std::uint32_t *p)
+    {
+        return _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+    }
+    static void store(std::uint32_t *p, Vector v)
+    {
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(p), v);
+    }
+    static Vector set(int v)
+    {
+        return _mm256_set1_epi16(static_cast<short>(v));
+    }
+    static Vector lanes(int b, int g, int r, int a)
+    {
+        return _mm256_broadcastsi128_si256(_mm_setr_epi16(b, g, r, a, b, g, r, a));
+    }
+    static Vector unpackLo(Vector v)
+    {
+        return _mm256_unpacklo_epi8(v, _mm256_setzero_si256());
+    }
+    static Vector unpackHi(Vector v)
+    {
+        return _mm256_unpackhi_epi8(v, _mm256_setzero_si256());
+    }
+    static Vector pack(Vector lo, Vector hi)
+    {
+        return _mm256_packus_epi16(lo, hi);
+    }
+    template <int Order>
+    static Vector shuffle(Vector v)
+    {
+        return _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(v, Order), Order);
+    }
+    static Vector add(Vector x, Vector y)
+    {
+        return _mm256_add_epi16(x, y);
+    }
+    static Vector subs(Vector x, Vector y)
+    {
+        return _mm256_subs_epu16(x, y);
+    }
+    static Vector mul(Vector x, Vector y)
+    {
+        return _mm256_mullo_epi16(x, y);
+    }
+    static Vector shr8(Vector v)
+    {
+        return _mm256_srli_epi16(v, 8);
+    }
+    static Vector min(Vector x, Vector y)
+    {
+        return _mm256_min_epi16(x, y);
+    }
+    static Vector bitAnd(Vector x, Vector y)
+    {
+        return _mm256_and_si256(x, y);
+    }
+    static Vector bitOr(Vector x, Vector y)
+    {
+        return _mm256_or_si256(x, y);
+    }
+};
+#endif
+
+// Lane orders of the shuffles: alpha to every lane, swap neighbours, swap pairs
+constexpr int ShuffleAlpha = 0xFF;
+constexpr int ShufflePairs = 0xB1;
+constexpr int ShuffleHalves = 0x4E;
+
+template <typename V>
+struct VectorStep
+{
+    typename V::Vector factor;
+    typename V::Vector inverse;
+    typename V::Vector color;
+};
+
+template <typename V>
+static inline typename V::Vector mulDiv255(typename V::Vector x, typename V::Vector y)
+{
+    typename V::Vector t = V::add(V::mul(x, y), V::set(128));
+    return V::shr8(V::add(t, V::shr8(t)));
+}
+
+template <typename V>
+static inline typename V::Vector applyStep(const FilterStep &step, const VectorStep<V> &vs, typename V::Vector c, typename V::Vector a)
+{
+    typename V::Vector t;
+    const typename V::Vector colorMask = V::lanes(0xFFFF, 0xFFFF, 0xFFFF, 0);
+    switch(step.kind)
+    {
+        case FilterKind::Brightness:
+            t = V::bitAnd(mulDiv255<V>(a, vs.factor), colorMask);
+            return step.amount > 0 ? V::min(V::add(c, t), a) : V::subs(c, t);
+        case FilterKind::Tint:
+            t = mulDiv255<V>(a, vs.color);
+            break;
+        default: // desaturate
+            t = V::mul(c, vs.color);
+            t = V::add(t, V::template shuffle<ShufflePairs>(t));
+            t = V::shr8(V::add(t, V::template shuffle<ShuffleHalves>(t)));
+            t = V::bitOr(V::bitAnd(t, colorMask), V::bitAnd(a, V::lanes(0, 0, 0, 0xFFFF)));
+            break;
+    }
+    return V::shr8(V::add(V::mul(c, vs.inverse), V::mul(t, vs.factor)));
+}
+
+// Filter the whole vectors from pos on, pos ends at the first pixel left over
+template <typename V>
+static void applyVector(const FilterStep *steps, int count, std::uint32_t *pixels, int &pos, int size)
+{
+    int z, f;
+    typename V::Vector lo, hi, alo, ahi;
+    std::array<VectorStep<V>, MaxFilterSteps> vs;
+    for(z = 0; z < count; ++z)
+    {
+        const FilterStep &step = steps[z];
+        switch(step.kind)
+        {
+            case FilterKind::Brightness:
+                vs[z].factor = V::set(std::abs(step.amount));
+                break;
+            case FilterKind::Tint:
+            case FilterKind::Desaturate:
+                f = blendFactor(step.amount);
+                vs[z].factor = V::set(f);
+                vs[z].inverse = V::set(256 - f);
+                if(step.kind == FilterKind::Tint)
+                    vs[z].color = V::lanes(step.color & 0xFF, step.color >> 8 & 0xFF, step.color >> 16 & 0xFF, 255);
+                else
+                    vs[z].color = V::lanes(GrayBlue, GrayGreen, GrayRed, 0);
+                break;
+        }
+    }
+
+    for(; pos + V::Pixels <= size; pos += V::Pixels)
+    {
+        lo = V::load(pixels + pos);
+        hi = V::unpackHi(lo);
+        lo = V::unpackLo(lo);
+        alo = V::template shuffle<ShuffleAlpha>(lo);
+        ahi = V::template shuffle<ShuffleAlpha>(hi);
+        for(z = 0; z < count; ++z)
+        {
+            lo = applyStep<V>(steps[z], vs[z], lo, alo);
+            hi = applyStep<V>(steps[z], vs[z], hi, ahi);
+        }
+        V::store(pixels + pos, V::pack(lo, hi));
+    }
+}
+
+#endif
+
+ImageFilter::ImageFilter() : _steps(), _count(0)
+{
+}
+
+void ImageFilter::add(FilterKind kind, int amount, std::uint32_t color)
+{
+    if(_count == MaxFilterSteps || amount == 0)
+        return;
+    _steps[_count++] = {kind, amount, color};
+}
+
+ImageFilter &ImageFilter::brightness(int amount)
+{
+    add(FilterKind::Brightness, std::clamp(amount, -255, 255), 0);
+    return *this;
+}
+
+ImageFilter &ImageFilter::tint(std::uint32_t color, int strength)
+{
+    add(FilterKind::Tint, std::clamp(strength, 0, 255), color & 0xFFFFFF);
+    return *this;
+}
+
+ImageFilter &ImageFilter::desaturate(int amount)
+{
+    add(FilterKind::Desaturate, std::clamp(amount, 0, 255), 0);
+    return *this;
+}
+
+bool ImageFilter::empty() const
+{
+    return _count == 0;
+}
+
+void ImageFilter::clear()
+{
+    _count = 0;
+}
+
+void ImageFilter::apply(std::uint32_t *pixels, int count) const
+{
+    int pos = 0;
+    if(_count == 0 || count <= 0)
+        return;
+#ifdef PB_FILTER_AVX2
+    applyVector<Avx2>(_steps.data(), _count, pixels, pos, count);
+#endif
+#ifdef PB_FILTER_SSE2
+    applyVector<Sse2>(_steps.data(), _count, pixels, pos, count);
+#endif
+    applyScalar(_steps.data(), _count, pixels + pos, count - pos);
+}
+
+const char *ImageFilter::kernel()
+{
+#if defined(PB_FILTER_AVX2)
+    return "avx2";
+#elif defined(PB_FILTER_SSE2)
+    return "sse2";
+#else
+    return "scalar";
+#endif
+}
@@ -0,0 +1,146 @@
+#include <algorithm>
+#include <cstdio>
+
+#include "PixelProfiler.h"
+
+static const char *PhaseNames[ProfilePhaseCount] = {"input", "logic", "sound", "grid", "cells", "destroy", "tray", "held", "text"};
+
+FrameProfiler::FrameProfiler() : _enabled(false), _samples(), _next(0), _count(0), _frames(0), _stack(), _depth(0)
+{
+}
+
+void FrameProfiler::setEnabled(bool value)
+{
+    if(_enabled == value)
+        return;
+    _enabled = value;
+    // the old samples would show the gap while it was off
+    _next = 0;
+    _count = 0;
+    _depth = 0;
+    _samples[0] = {};
+    _frameStart = Clock::now();
+}
+
+bool FrameProfiler::enabled() const
+{
+    return _enabled;
+}
+
+void FrameProfiler::account(Clock::time_point now)
+{
+    if(_depth > 0)
+        _samples[_next].phases[static_cast<int>(_stack[_depth - 1])] += std::chrono::duration_cast<std::chrono::nanoseconds>(now - _phaseStart).count();
+    _phaseStart = now;
+}
+
+void FrameProfiler::beginFrame()
+{
+    Clock::time_point now;
+    if(!_enabled)
+        return;
+    now = Clock::now();
+    account(now);
+    _samples[_next].interval = std::chrono::duration_cast<std::chrono::nanoseconds>(now - _frameStart).count();
+    _frameStart = now;
+    _next = (_next + 1) % ProfileFrames;
+    _count = std::min(_count + 1, ProfileFrames);
+    _samples[_next] = {};
+    ++_frames;
+}
+
+void FrameProfiler::push(ProfilePhase phase)
+{
+    if(!_enabled)
+        return;
+    account(Clock::now());
+    if(_depth < MaxProfileDepth)
+        _stack[_depth] = phase;
+    ++_depth;
+}
+
+void FrameProfiler::pop()
+{
+    if(!_enabled || _depth == 0)
+        return;
+    // a phase deeper than the stack is counted in the last one kept
+    if(_depth <= MaxProfileDepth)
+        account(Clock::now());
+    --_depth;
+}
+
+int FrameProfiler::sampleCount() const
+{
+    return _count;
+}
+
+const ProfileSample &FrameProfiler::sample(int age) const
+{
+    return _samples[(_next - 1 - age + 2 * ProfileFrames) % ProfileFrames];
+}
+
+std::int64_t FrameProfiler::average(ProfilePhase phase) const
+{
+    int x;
+    std::int64_t sum = 0;
+    for(x = 0; x < _count; ++x)
+        sum += sample(x).phases[static_cast<int>(phase)];
+    return _count > 0 ? sum / _count : 0;
+}
+
+std::int64_t FrameProfiler::maximum(ProfilePhase phase) const
+{
+    int x;
+    std::int64_t result = 0;
+    for(x = 0; x < _count; ++x)
+        result = std::max(result, sample(x).phases[static_cast<int>(phase)]);
+    return result;
+}
+
+bool FrameProfiler::writeCsv(const char *path) const
+{
+    int x, y;
+    bool ok;
+    std::FILE *file = std::fopen(path, "w");
+    if(file == nullptr)
+        return false;
+    std::fputs("frame,interval_ms", file);
+    for(y = 0; y < ProfilePhaseCount; ++y)
+        std::fprintf(file, ",%s_ms", PhaseNames[y]);
+    std::fputc('\n', file);
+    for(x = _count - 1; x >= 0; --x)
+    {
+        const ProfileSample &s = sample(x);
+        std::fprintf(file, "%llu,%.4f", static_cast<unsigned long long>(_frames - x), s.interval / 1e6);
+        for(y = 0; y < ProfilePhaseCount; ++y)
+            std::fprintf(file, ",%.4f", s.phases[y] / 1e6);
+        std::fputc('\n', file);
+    }
+    ok = std::ferror(file) == 0;
+    return std::fclose(file) == 0 && ok;
+}
+
+const char *FrameProfiler::phaseName(ProfilePhase phase)
+{
+    return PhaseNames[static_cast<int>(phase)];
+}
+
+ProfileScope::ProfileScope(FrameProfiler *profiler, ProfilePhase phase) : _profiler(profiler != nullptr && profiler->enabled() ? profiler : nullptr)
+{
+    if(_profiler != nullptr)
+        _profiler->push(phase);
+}
+
+ProfileScope::~ProfileScope()
+{
+    if(_profiler != nullptr)
+        _profiler->pop();
+}
+
+void ProfileScope::next(ProfilePhase phase)
+{
+    if(_profiler == nullptr)
+        return;
+    _profiler->pop();
+    _profiler->push(phase);
+}
@@ -0,0 +1,146 @@
+#include <algorithm>
+#include <cstring>
+
+#include "PixelReplay.h"
+
+ReplayHeader replayHeader(const GameEngine &engine)
+{
+    ReplayHeader header;
+    header.width = engine.state().width;
+    header.mode = engine.candidateMode();
+    header.colorCount = engine.colorCount();
+    header.difficulty = engine.difficulty();
+    header.rotation = engine.state().rotation;
+    header.seed = engine.seed();
+    return header;
+}
+
+void encodeReplayHeader(const ReplayHeader &header, std::uint8_t *out)
+{
+    int x;
+    std::memcpy(out, ReplayMagic, sizeof(ReplayMagic));
+    out[4] = static_cast<std::uint8_t>(header.version);
+    out[5] = static_cast<std::uint8_t>(header.width);
+    out[6] = header.mode == CandidateMode::Random ? 1 : 0;
+    out[7] = static_cast<std::uint8_t>(header.colorCount);
+    out[8] = static_cast<std::uint8_t>(static_cast<std::int8_t>(header.difficulty));
+    out[9] = header.rotation ? 1 : 0;
+    out[10] = out[11] = 0;
+    for(x = 0; x < 8; ++x)
+        out[12 + x] = static_cast<std::uint8_t>(header.seed >> (x * 8));
+}
+
+bool decodeReplayHeader(const std::uint8_t *data, ReplayHeader &header)
+{
+    int x;
+    if(std::memcmp(data, ReplayMagic, sizeof(ReplayMagic)) != 0)
+        return false;
+    header.version = data[4];
+    header.width = data[5];
+    header.mode = data[6] == 1 ? CandidateMode::Random : CandidateMode::Selective;
+    header.colorCount = data[7];
+    header.difficulty = static_cast<std::int8_t>(data[8]);
+    header.rotation = (data[9] & 0x1) != 0;
+    header.seed = 0;
+    for(x = 0; x < 8; ++x)
+        header.seed |= static_cast<std::uint64_t>(data[12 + x]) << (x * 8);
+    return header.version == ReplayVersion && header.width >= MinBoardWidth && header.width <= MaxBoardWidth;
+}
+
+bool decodeReplay(const std::uint8_t *data, std::size_t size, Replay &replay)
+{
+    std::size_t z;
+
+    replay.moves.clear();
+    if(size < ReplayHeaderSize || !decodeReplayHeader(data, replay.header))
+        return false;
+
+    // a trailing half record is a write cut by a crash, it is dropped
+    replay.moves.reserve((size - ReplayHeaderSize) / ReplayRecordSize);
+    for(z = ReplayHeaderSize; z + ReplayRecordSize <= size; z += ReplayRecordSize)
+        replay.moves.push_back({data[z] & 0x3, data[z + 1], data[z] >> 2 & 0x3});
+    return true;
+}
+
+bool loadReplay(const char *path, Replay &replay)
+{
+    long size;
+    std::vector<std::uint8_t> data;
+    std::FILE *file = std::fopen(path, "rb");
+    if(file == nullptr)
+        return false;
+    if(std::fseek(file, 0, SEEK_END) != 0 || (size = std::ftell(file)) < 0 || std::fseek(file, 0, SEEK_SET) != 0)
+    {
+        std::fclose(file);
+        return false;
+    }
+    data.resize(static_cast<std::size_t>(size));
+    size = static_cast<long>(std::fread(data.data(), 1, data.size(), file));
+    std::fclose(file);
+    return decodeReplay(data.data(), static_cast<std::size_t>(size), replay);
+}
+
+void startReplay(GameEngine &engine, const ReplayHeader &header)
+{
+    engine.setBoardWidth(header.width);
+    engine.setCandidateMode(header.mode);
+    engine.setColorCount(header.colorCount);
+    engine.setDifficulty(header.difficulty);
+    engine.setRotation(header.rotation);
+    engine.setSeed(header.seed);
+    engine.reset();
+}
+
+int replayMoves(GameEngine &engine, const Replay &replay, int count)
+{
+    int x, last = static_cast<int>(replay.moves.size());
+    if(count >= 0)
+        last = std::min(last, count);
+    startReplay(engine, replay.header);
+    for(x = 0; x < last; ++x)
+    {
+        if(!engine.applyMove(replay.moves[x]).placed)
+            break;
+    }
+    return x;
+}
+
+ReplayWriter::~ReplayWriter()
+{
+    close();
+}
+
+bool ReplayWriter::open(const char *path, const ReplayHeader &header)
+{
+    std::uint8_t buffer[ReplayHeaderSize];
+    close();
+    if((_file = std::fopen(path, "wb")) == nullptr)
+        return false;
+    encodeReplayHeader(header, buffer);
+    if(std::fwrite(buffer, 1, sizeof(buffer), _file) != sizeof(buffer) || std::fflush(_file) != 0)
+    {
+        close();
+        return false;
+    }
+    return true;
+}
+
+bool ReplayWriter::append(const Move &move)
+{
+    std::uint8_t record[ReplayRecordSize] = {static_cast<std::uint8_t>((move.rotation & 0x3) << 2 | (move.candidate & 0x3)), static_cast<std::uint8_t>(move.cell)};
+    if(_file == nullptr)
+        return false;
+    return std::fwrite(record, 1, sizeof(record), _file) == sizeof(record) && std::fflush(_file) == 0;
+}
+
+void ReplayWriter::close()
+{
+    if(_file != nullptr)
+        std::fclose(_file);
+    _file = nullptr;
+}
+
+bool ReplayWriter::isOpen() const
+{
+    return _file != nullptr;
+}
@@ -0,0 +1,257 @@
+#include <algorithm>
+#include <bit>
+
+#include "PixelSolver.h"
+
+using SolverClock = std::chrono::steady_clock;
+
+// Key of every cell, then of every (candidate slot, shape) pair, of every board width and of the rotation mode
+struct ZobristKeys
+{
+    std::array<std::uint64_t, BoardCells> cells {};
+    std::array<std::array<std::uint64_t, MaxShapes>, MaxCandidates> candidates {};
+    std::array<std::uint64_t, MaxBoardWidth + 1> width {};
+    std::uint64_t rotation = 0;
+};
+
+constexpr ZobristKeys makeZobristKeys()
+{
+    int x, y;
+    std::uint64_t state = 0x5049584C424C5354ULL;
+    ZobristKeys keys;
+    for(x = 0; x < BoardCells; ++x)
+        keys.cells[x] = state = mixSeed(state);
+    for(x = 0; x < MaxCandidates; ++x)
+    {
+        for(y = 0; y < MaxShapes; ++y)
+            keys.candidates[x][y] = state = mixSeed(state);
+    }
+    for(x = 0; x <= MaxBoardWidth; ++x)
+        keys.width[x] = state = mixSeed(state);
+    keys.rotation = mixSeed(state);
+    return keys;
+}
+
+constexpr ZobristKeys Zobrist = makeZobristKeys();
+
+std::uint64_t zobristHash(const Bitboard &grids)
+{
+    std::uint64_t hash = 0;
+    Bitboard cells = grids;
+    while(cells.any())
+        hash ^= Zobrist.cells[cells.takeFirst()];
+    return hash;
+}
+
+int evaluateBoard(const Bitboard &grids, int width)
+{
+    constexpr Bitboard FirstColumn = bitColumn(0, MaxBoardWidth);
+    constexpr Bitboard LastColumn = bitColumn(MaxBoardWidth - 1, MaxBoardWidth);
+    constexpr Bitboard FirstRow = bitRow(0, MaxBoardWidth);
+    constexpr Bitboard LastRow = bitRow(MaxBoardWidth - 1, MaxBoardWidth);
+
+    // cells outside of the board count as walls
+    Bitboard board = bitBoard(width);
+    Bitboard walls = grids | ~board;
+    Bitboard empty = board & ~grids;
+    Bitboard left = (walls << 1) | FirstColumn;
+    Bitboard right = (walls >> 1) | LastColumn;
+    Bitboard up = (walls << BoardStride) | FirstRow;
+    Bitboard down = (walls >> BoardStride) | LastRow;
+    Bitboard holes = empty & left & right & up & down;
+    Bitboard gaps = empty & ((left & right) | (up & down));
+    return -(holes.count() * 10 + gaps.count());
+}
+
+GameSolver::GameSolver(int tableBits) : _width(DefaultBoardWidth), _rotation(false), _stopped(false), _nodes(0), _nodeLimit(0), _deadline(), _shapes(), _lines(), _lineCounts(), _table(std::size_t {1} << std::clamp(tableBits, 8, 24))
+{
+    // every root move of the largest board, solve() does not allocate
+    _roots.reserve(MaxCandidates * MaxRotations * BoardCells);
+    clearTable();
+}
+
+void GameSolver::setNodeLimit(std::uint64_t nodes)
+{
+    _nodeLimit = nodes;
+}
+
+void GameSolver::clearTable()
+{
+    std::fill(std::begin(_table), std::end(_table), Entry {0, 0, 0, {}});
+}
+
+std::uint64_t GameSolver::remainingKey(unsigned remaining) const
+{
+    int x;
+    // the board width and the rotation mode change every value, mix them in as well
+    std::uint64_t key = Zobrist.width[_width] ^ (_rotation ? Zobrist.rotation : 0);
+    for(x = 0; x < MaxCandidates; ++x)
+    {
+        if(remaining & (1U << x))
+            key ^= Zobrist.candidates[x][_shapes[x]];
+    }
+    return key;
+}
+
+void GameSolver::timeCheck()
+{
+    ++_nodes;
+    // a node limit replaces the clock, which is read every 1024 nodes otherwise
+    if(_nodeLimit != 0)
+    {
+        if(_nodes >= _nodeLimit)
+            _stopped = true;
+    }
+    else if((_nodes & 1023) == 0 && SolverClock::now() >= _deadline)
+        _stopped = true;
+}
+
+int GameSolver::search(const Bitboard &grids, std::uint64_t hash, unsigned remaining, int depth)
+{
+    int x, y, z, r, lines, value, best;
+    std::uint64_t key, nextHash;
+    Bitboard next, cleared;
+
+    _lineCounts[depth] = 0;
+    if(remaining == 0)
+        return evaluateBoard(grids, _width);
+
+    timeCheck();
+    if(_stopped)
+        return SolverDeadEnd * MaxCandidates;
+
+    key = hash ^ remainingKey(remaining);
+    Entry &entry = _table[key & (_table.size() - 1)];
+    if(entry.key == key)
+    {
+        _lineCounts[depth] = entry.count;
+        for(x = 0; x < entry.count; ++x)
+            _lines[depth][x] = {entry.moves[x] >> 8 & 0x3, entry.moves[x] & 0xFF, entry.moves[x] >> 10};
+        return entry.value;
+    }
+
+    best = SolverDeadEnd * std::popcount(remaining);
+    for(z = 0; z < MaxCandidates; ++z)
+    {
+        if(!(remaining & (1U << z)))
+            continue;
+        for(r = 0; r < GameEngine::orientationCount(_shapes[z], _rotation); ++r)
+        {
+            const ShapeInfo &info = getShape(rotateShape(_shapes[z], r));
+            for(x = 0; x <= _width - info.columns; ++x)
+            {
+                for(y = 0; y <= _width - info.rows; ++y)
+                {
+                    const Bitboard &placement = info.placements[y * BoardStride + x];
+                    if(grids.intersects(placement))
+                        continue;
+                    next = grids | placement;
+                    nextHash = hash ^ zobristHash(placement);
+                    cleared = GameEngine::clearLines(next, _width, lines);
+                    nextHash ^= zobristHash(cleared);
+                    value = lines * SolverLineValue + search(next, nextHash, remaining & ~(1U << z), depth + 1);
+                    if(_stopped)
+                        return best;
+                    if(value > best)
+                    {
+                        best = value;
+                        _lines[depth][0] = {z, y * BoardStride + x, r};
+                        std::copy_n(std::begin(_lines[depth + 1]), _lineCounts[depth + 1], std::begin(_lines[depth]) + 1);
+                        _lineCounts[depth] = _lineCounts[depth + 1] + 1;
+                    }
+                }
+            }
+        }
+    }
+
+    entry.key = key;
+    entry.value = best;
+    entry.count = static_cast<std::uint8_t>(_lineCounts[depth]);
+    for(x = 0; x < _lineCounts[depth]; ++x)
+        entry.moves[x] = static_cast<std::uint16_t>(_lines[depth][x].rotation << 10 | _lines[depth][x].candidate << 8 | _lines[depth][x].cell);
+    return best;
+}
+
+SolverResult GameSolver::solve(const GameState &state, std::chrono::microseconds budget)
+{
+    int x, y, z, r, value;
+    unsigned remaining = 0;
+    std::uint64_t hash;
+    SolverResult result;
+
+    _width = state.width;
+    _rotation = state.rotation;
+    _stopped = false;
+    _nodes = 0;
+    _deadline = SolverClock::now() + budget;
+    for(z = 0; z < MaxCandidates; ++z)
+    {
+        _shapes[z] = state.candidates[z].shape;
+        if(_shapes[z] != -1)
+            remaining |= 1U << z;
+    }
+    result.value = SolverDeadEnd * std::popcount(remaining);
+    if(state.over || remaining == 0)
+    {
+        result.complete = true;
+        result.doomed = remaining != 0;
+        return result;
+    }
+
+    // the root moves are ordered by the board right after them, so the best lines come first
+    // and a short budget still returns a strong sequence
+    hash = zobristHash(state.occupied);
+    _roots.clear();
+    for(z = 0; z < MaxCandidates; ++z)
+    {
+        if(!(remaining & (1U << z)))
+            continue;
+        for(r = 0; r < GameEngine::orientationCount(_shapes[z], _rotation); ++r)
+        {
+            const ShapeInfo &info = getShape(rotateShape(_shapes[z], r));
+            for(x = 0; x <= _width - info.columns; ++x)
+            {
+                for(y = 0; y <= _width - info.rows; ++y)
+                {
+                    const Bitboard &placement = info.placements[y * BoardStride + x];
+                    if(state.occupied.intersects(placement))
+                        continue;
+                    RootMove &root = _roots.emplace_back();
+                    root.move = {z, y * BoardStride + x, r};
+                    root.grids = state.occupied | placement;
+                    root.hash = hash ^ zobristHash(placement);
+                    root.hash ^= zobristHash(GameEngine::clearLines(root.grids, _width, root.lines));
+                    root.order = root.lines * SolverLineValue + evaluateBoard(root.grids, _width);
+                }
+            }
+        }
+    }
+    std::sort(std::begin(_roots), std::end(_roots), [](const RootMove &a, const RootMove &b) { return a.order > b.order; });
+
+    for(const RootMove &root : _roots)
+    {
+        value = root.lines * SolverLineValue + search(root.grids, root.hash, remaining & ~(1U << root.move.candidate), 1);
+        // a root move is taken only with its whole subtree searched
+        if(_stopped)
+            break;
+        if(result.count == 0 || value > result.value)
+        {
+            result.value = value;
+            result.moves[0] = root.move;
+            std::copy_n(std::begin(_lines[1]), _lineCounts[1], std::begin(result.moves) + 1);
+            result.count = _lineCounts[1] + 1;
+        }
+    }
+
+    // no subtree finished in the budget: fall back to the best looking first move
+    if(result.count == 0 && !_roots.empty())
+    {
+        result.moves[0] = _roots[0].move;
+        result.count = 1;
+    }
+
+    result.complete = !_stopped;
+    result.doomed = result.complete && result.value < SolverDeadEnd / 2;
+    result.nodes = _nodes;
+    return result;
+}
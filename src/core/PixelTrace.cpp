@@ -0,0 +1,184 @@
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <vector>
+
+#include "PixelTrace.h"
+
+#ifdef PB_TRACE
+
+struct TraceEvent
+{
+    const char *name;
+    std::int64_t start;
+    // Length of a complete event, the id of an async one
+    std::uint64_t value;
+    char phase;
+};
+
+struct TraceBuffer
+{
+    std::array<TraceEvent, TraceBufferEvents> events;
+    // Events written so far, the last TraceBufferEvents of them are kept
+    std::atomic<std::uint64_t> count {0};
+    int thread = 0;
+    const char *threadName = nullptr;
+};
+
+static const std::chrono::steady_clock::time_point traceStart = std::chrono::steady_clock::now();
+
+static std::mutex &registryMutex()
+{
+    static std::mutex mutex;
+    return mutex;
+}
+
+// Never freed: a thread may trace until the process ends
+static std::vector<TraceBuffer *> &registry()
+{
+    static std::vector<TraceBuffer *> *buffers = new std::vector<TraceBuffer *>();
+    return *buffers;
+}
+
+static TraceBuffer &threadBuffer()
+{
+    thread_local TraceBuffer *buffer = nullptr;
+    if(buffer == nullptr)
+    {
+        std::lock_guard<std::mutex> lock(registryMutex());
+        buffer = new TraceBuffer();
+        buffer->thread = static_cast<int>(registry().size()) + 1;
+        registry().push_back(buffer);
+    }
+    return *buffer;
+}
+
+static void record(const char *name, char phase, std::int64_t start, std::uint64_t value)
+{
+    TraceBuffer &buffer = threadBuffer();
+    std::uint64_t index = buffer.count.load(std::memory_order_relaxed);
+    buffer.events[index % TraceBufferEvents] = {name, start, value, phase};
+    // the writer reads the events below the count
+    buffer.count.store(index + 1, std::memory_order_release);
+}
+
+static void writeName(std::FILE *file, const char *name)
+{
+    std::fputc('"', file);
+    for(; *name != '\0'; ++name)
+    {
+        if(*name == '"' || *name == '\\')
+            std::fputc('\\', file);
+        std::fputc(*name, file);
+    }
+    std::fputc('"', file);
+}
+
+bool traceEnabled()
+{
+    return true;
+}
+
+std::int64_t traceNow()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - traceStart).count();
+}
+
+void traceComplete(const char *name, std::int64_t start, std::int64_t end)
+{
+    record(name, 'X', start, static_cast<std::uint64_t>(end - start));
+}
+
+void traceAsync(const char *name, char phase, std::uint64_t id)
+{
+    record(name, phase, traceNow(), id);
+}
+
+void traceInstant(const char *name)
+{
+    record(name, 'i', traceNow(), 0);
+}
+
+void traceThreadName(const char *name)
+{
+    threadBuffer().threadName = name;
+}
+
+bool writeTrace(const char *path)
+{
+    bool ok, first = true;
+    std::uint64_t x, count;
+    std::FILE *file = std::fopen(path, "w");
+    if(file == nullptr)
+        return false;
+
+    std::lock_guard<std::mutex> lock(registryMutex());
+    std::fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[", file);
+    for(const TraceBuffer *buffer : registry())
+    {
+        if(buffer->threadName != nullptr)
+        {
+            std::fprintf(file, "%s\n{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":", first ? "" : ",", buffer->thread);
+            writeName(file, buffer->threadName);
+            std::fputs("}}", file);
+            first = false;
+        }
+        count = buffer->count.load(std::memory_order_acquire);
+        for(x = count > TraceBufferEvents ? count - TraceBufferEvents : 0; x < count; ++x)
+        {
+            const TraceEvent &event = buffer->events[x % TraceBufferEvents];
+            std::fprintf(file, "%s\n{\"ph\":\"%c\",\"name\":", first ? "" : ",", event.phase);
+            writeName(file, event.name);
+            // microseconds with the nanoseconds as decimals
+            std::fprintf(file, ",\"pid\":1,\"tid\":%d,\"ts\":%.3f", buffer->thread, event.start / 1e3);
+            if(event.phase == 'X')
+                std::fprintf(file, ",\"dur\":%.3f", event.value / 1e3);
+            else if(event.phase == 'i')
+                std::fputs(",\"s\":\"t\"", file);
+            else
+                std::fprintf(file, ",\"cat\":\"async\",\"id\":\"0x%llx\"", static_cast<unsigned long long>(event.value));
+            std::fputc('}', file);
+            first = false;
+        }
+    }
+    std::fputs("\n]}\n", file);
+    ok = std::ferror(file) == 0;
+    return std::fclose(file) == 0 && ok;
+}
+
+#else
+
+bool traceEnabled()
+{
+    return false;
+}
+
+std::int64_t traceNow()
+{
+    return 0;
+}
+
+void traceComplete(const char *, std::int64_t, std::int64_t)
+{
+}
+
+void traceAsync(const char *, char, std::uint64_t)
+{
+}
+
+void traceInstant(const char *)
+{
+}
+
+void traceThreadName(const char *)
+{
+}
+
+bool writeTrace(const char *)
+{
+    return false;
+}
+
+#endif
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstdint>
+
+/*
+    Heap allocation counter for the frame loop. Configured with -DPB_ALLOC_TRACE=ON the core
+    library counts every allocation of the process; otherwise the counter stays 0 and costs
+    nothing. Compare two readings around a frame: a steady frame must read 0.
+
+    With glibc the core, a shared library linked once, wraps malloc, calloc, realloc and the
+    aligned allocations: operator new and the storage of QString, QList and QByteArray are
+    counted from every module and every thread, other threads of the process included.
+    Elsewhere it replaces the global operator new only, and on Windows that only sees the
+    allocations of the core itself: malloc and the Qt containers are not counted there.
+    Pages mapped with mmap or VirtualAlloc directly are never counted.
+*/
+
+bool allocationTraceEnabled();
+
+// Allocations since the start of the process
+std::uint64_t allocationCount();
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include "PixelGameEngine.h"
+#include "PixelReplay.h"
+
+/*
+    Autosave file: two slots written in turn, the one the sequence number selects.
+    A write cut by a crash breaks only the checksum of its slot, the other slot keeps
+    the previous move. Slot layout:
+
+        offset  size
+        0       4     sequence number, little-endian
+        4       4     checksum (FNV-1a) of the sequence and the bytes from offset 8
+        8       20    replay header: settings and seed of the game
+        28      64    GameSnapshot, native byte order
+        92      256   colors of the occupied cells in the order of Bitboard::takeFirst()
+
+    The file is small and fixed-size, so it is mapped in memory: a save is a copy of a few
+    hundred bytes and the system writes the pages back in its own time.
+*/
+
+constexpr int AutosaveSlotSize = 92 + BoardCells;
+constexpr int AutosaveSize = AutosaveSlotSize * 2;
+
+struct Autosave
+{
+    std::uint32_t sequence = 0;
+    ReplayHeader header;
+    GameSnapshot snapshot {};
+    std::array<std::uint8_t, BoardCells> colors {};
+};
+
+// Save the game to the slot of the sequence number, file holds AutosaveSize bytes
+void writeAutosave(std::uint8_t *file, const GameEngine &engine, std::uint32_t sequence);
+// The newest valid slot, false when there is none
+bool readAutosave(const std::uint8_t *file, std::size_t size, Autosave &save);
+// Configure the engine with the settings of the save and continue its game, a finished game is not resumed
+bool resumeAutosave(GameEngine &engine, const Autosave &save);
@@ -0,0 +1,184 @@
+#pragma once
+
+#include <array>
+#include <bit>
+#include <cstdint>
+
+/*
+    Board packed into a 256-bit mask with a fixed row stride of MaxBoardWidth bits.
+    Cell (x, y) is the bit (y * BoardStride + x), row 0 is the lowest 16 bits:
+
+        bit   0 .. 15  -> row 0
+        bit  16 .. 31  -> row 1
+        ...
+        bit 240 .. 255 -> row 15
+
+    Smaller boards (8x8, 10x10, 12x12) use the top-left corner of the mask, so one type
+    serves every board size and all operations stay a few word operations whatever the size.
+*/
+
+constexpr int MaxBoardWidth = 16;
+constexpr int MinBoardWidth = 5;
+constexpr int DefaultBoardWidth = 8;
+constexpr int BoardStride = MaxBoardWidth;
+constexpr int BoardCells = BoardStride * MaxBoardWidth;
+constexpr int BitboardWords = BoardCells / 64;
+
+constexpr std::array<int, 4> BoardSizes = {8, 10, 12, 16};
+
+struct Bitboard
+{
+    std::array<std::uint64_t, BitboardWords> words {};
+
+    constexpr bool any() const
+    {
+        return (words[0] | words[1] | words[2] | words[3]) != 0;
+    }
+
+    constexpr bool none() const
+    {
+        return !any();
+    }
+
+    constexpr bool intersects(const Bitboard &other) const
+    {
+        return ((words[0] & other.words[0]) | (words[1] & other.words[1]) | (words[2] & other.words[2]) | (words[3] & other.words[3])) != 0;
+    }
+
+    constexpr bool test(int idx) const
+    {
+        return ((words[idx >> 6] >> (idx & 63)) & 0x1) != 0;
+    }
+
+    constexpr void set(int idx)
+    {
+        words[idx >> 6] |= std::uint64_t {1} << (idx & 63);
+    }
+
+    constexpr int count() const
+    {
+        return std::popcount(words[0]) + std::popcount(words[1]) + std::popcount(words[2]) + std::popcount(words[3]);
+    }
+
+    // Index of the lowest set cell, -1 on the empty board
+    constexpr int first() const
+    {
+        for(int x = 0; x < BitboardWords; ++x)
+        {
+            if(words[x] != 0)
+                return x * 64 + std::countr_zero(words[x]);
+        }
+        return -1;
+    }
+
+    // Remove the lowest set cell and return its index
+    constexpr int takeFirst()
+    {
+        for(int x = 0; x < BitboardWords; ++x)
+        {
+            if(words[x] != 0)
+            {
+                int idx = x * 64 + std::countr_zero(words[x]);
+                words[x] &= words[x] - 1;
+                return idx;
+            }
+        }
+        return -1;
+    }
+
+    constexpr Bitboard operator<<(int n) const
+    {
+        int x, w = n >> 6, s = n & 63;
+        Bitboard out;
+        for(x = BitboardWords - 1; x >= w; --x)
+        {
+            out.words[x] = words[x - w] << s;
+            if(s != 0 && x - w - 1 >= 0)
+                out.words[x] |= words[x - w - 1] >> (64 - s);
+        }
+        return out;
+    }
+
+    constexpr Bitboard operator>>(int n) const
+    {
+        int x, w = n >> 6, s = n & 63;
+        Bitboard out;
+        for(x = 0; x < BitboardWords - w; ++x)
+        {
+            out.words[x] = words[x + w] >> s;
+            if(s != 0 && x + w + 1 < BitboardWords)
+                out.words[x] |= words[x + w + 1] << (64 - s);
+        }
+        return out;
+    }
+
+    constexpr Bitboard operator~() const
+    {
+        return {{~words[0], ~words[1], ~words[2], ~words[3]}};
+    }
+
+    constexpr Bitboard operator&(const Bitboard &other) const
+    {
+        return {{words[0] & other.words[0], words[1] & other.words[1], words[2] & other.words[2], words[3] & other.words[3]}};
+    }
+
+    constexpr Bitboard operator|(const Bitboard &other) const
+    {
+        return {{words[0] | other.words[0], words[1] | other.words[1], words[2] | other.words[2], words[3] | other.words[3]}};
+    }
+
+    constexpr Bitboard &operator&=(const Bitboard &other)
+    {
+        return *this = *this & other;
+    }
+
+    constexpr Bitboard &operator|=(const Bitboard &other)
+    {
+        return *this = *this | other;
+    }
+
+    constexpr bool operator==(const Bitboard &other) const = default;
+};
+
+constexpr Bitboard bitCell(int idx)
+{
+    Bitboard b;
+    b.set(idx);
+    return b;
+}
+
+// Cells [0, width) of the row y
+constexpr Bitboard bitRow(int y, int width)
+{
+    Bitboard b;
+    b.words[0] = (std::uint64_t {1} << width) - 1;
+    return b << (y * BoardStride);
+}
+
+// Cells [0, width) of the column x
+constexpr Bitboard bitColumn(int x, int width)
+{
+    Bitboard b;
+    for(int y = 0; y < width; ++y)
+        b.set(y * BoardStride + x);
+    return b;
+}
+
+// Every cell of the width x width board
+constexpr Bitboard bitBoard(int width)
+{
+    Bitboard b;
+    for(int y = 0; y < width; ++y)
+        b |= bitRow(y, width);
+    return b;
+}
+
+constexpr int bitCount(const Bitboard &b)
+{
+    return b.count();
+}
+
+constexpr int bitFirst(const Bitboard &b)
+{
+    return b.first();
+}
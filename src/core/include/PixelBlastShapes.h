@@ -0,0 +1,328 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+#include "PixelBitboard.h"
+
+/* THE BIT (1 << 31) has Rotate state: the shape turns clockwise in the rotation mode */
+
+constexpr int StaticShapes[] = {
+    // --- SQUARE ---
+    /*
+        # # . . .
+        # # . . .
+        . . . . .
+    */
+    0x0303 | (1 << 31),
+
+    // --- LINE I ---
+    /*
+        # # # # .
+        . . . . .
+        . . . . .
+    */
+    0x0F | (1 << 31),
+    /*
+        # . . . .
+        # . . . .
+        # . . . .
+        # . . . .
+    */
+    0x01010101 | (1 << 31),
+
+    // --- ZETA (Z) ---
+    /*
+        . # # . .
+        # # . . .
+        . . . . .
+    */
+    0x0603 | (1 << 31),
+    /*
+        # . . . .
+        # # . . .
+        . # . . .
+    */
+    0x020301 | (1 << 31),
+
+    // --- S-SHAPE ---
+    /*
+        # # . . .
+        . # # . .
+        . . . . .
+    */
+    0x0306 | (1 << 31),
+    /*
+        . # . . .
+        # # . . .
+        # . . . .
+    */
+    0x010302 | (1 << 31),
+
+    // --- T-SHAPE ---
+    /*
+        . # . . .
+        # # # . .
+        . . . . .
+    */
+    0x0207 | (1 << 31),
+    /*
+        # . . . .
+        # # . . .
+        # . . . .
+    */
+    0x010301 | (1 << 31),
+    /*
+        # # # . .
+        . # . . .
+        . . . . .
+    */
+    0x0702 | (1 << 31),
+    /*
+        . # . . .
+        # # . . .
+        . # . . .
+    */
+    0x020302 | (1 << 31),
+
+    // --- L-SHAPE ---
+    /*
+        # . . . .
+        # # # . .
+        . . . . .
+    */
+    0x0107 | (1 << 31),
+    /*
+        # # . . .
+        # . . . .
+        # . . . .
+    */
+    0x030101 | (1 << 31),
+    /*
+        # # # . .
+        . . # . .
+        . . . . .
+    */
+    0x0704 | (1 << 31),
+    /*
+        . # . . .
+        . # . . .
+        # # . . .
+    */
+    0x020203 | (1 << 31),
+
+    // --- J-SHAPE ---
+    /*
+        . . # . .
+        # # # . .
+        . . . . .
+    */
+    0x0407 | (1 << 31),
+    /*
+        # . . . .
+        # . . . .
+        # # . . .
+    */
+    0x010103 | (1 << 31),
+    /*
+        # # # . .
+        # . . . .
+        . . . . .
+    */
+    0x0701 | (1 << 31),
+    /*
+        # # . . .
+        . # . . .
+        . # . . .
+    */
+    0x030202 | (1 << 31),
+    /*
+        # # # . .
+        # # # . .
+        # # # . .
+    */
+    0x70707,
+    /*
+        # . . . .
+        . . . . .
+        . . . . .
+    */
+    0x1,
+    /*
+        # # . . .
+        . . . . .
+        . . . . .
+    */
+    0x3 | (1 << 31),
+    /*
+        # . . . .
+        # . . . .
+        . . . . .
+    */
+    0x101 | (1 << 31),
+    /*
+        # # . . .
+        # . . . .
+        . . . . .
+    */
+    0x103 | (1 << 31),
+    /*
+        # . . . .
+        # # . . .
+        . . . . .
+    */
+    0x301 | (1 << 31)};
+
+// Shapes of the candidate pool, the rotated orientations missing from it follow in the catalog
+constexpr int MaxShapes = sizeof(StaticShapes) / sizeof(StaticShapes[0]);
+constexpr int ShapeRotateBit = 1 << 31;
+constexpr int MaxShapeCells = 9;
+constexpr int MaxRotations = 4;
+// StaticShapes rows are 8 bits wide
+constexpr int StaticShapeStride = 8;
+
+// Encoded shape turned clockwise and moved back to the top-left corner, the rotate bit is kept
+constexpr int rotateStaticShape(int shape)
+{
+    int x, y, z, rows = 0, out = shape & ShapeRotateBit;
+    for(z = 0; z < 31; ++z)
+    {
+        if((shape >> z) & 0x1)
+            rows = z / StaticShapeStride + 1 > rows ? z / StaticShapeStride + 1 : rows;
+    }
+    for(z = 0; z < 31; ++z)
+    {
+        if(((shape >> z) & 0x1) == 0)
+            continue;
+        x = z % StaticShapeStride;
+        y = z / StaticShapeStride;
+        // (x, y) -> (rows - 1 - y, x)
+        out |= 1 << (x * StaticShapeStride + rows - 1 - y);
+    }
+    return out;
+}
+
+struct ShapeCodes
+{
+    std::array<int, MaxShapes * MaxRotations> codes {};
+    int count = 0;
+};
+
+// The pool closed under rotation: every missing orientation of a rotatable shape is appended
+constexpr ShapeCodes makeShapeCodes()
+{
+    int x, y, rotated;
+    ShapeCodes out;
+    for(x = 0; x < MaxShapes; ++x)
+        out.codes[out.count++] = StaticShapes[x];
+    for(x = 0; x < out.count; ++x)
+    {
+        if(!(out.codes[x] & ShapeRotateBit))
+            continue;
+        rotated = rotateStaticShape(out.codes[x]);
+        for(y = 0; y < out.count && (out.codes[y] & ~ShapeRotateBit) != (rotated & ~ShapeRotateBit); ++y)
+            ;
+        if(y == out.count)
+            out.codes[out.count++] = rotated;
+    }
+    return out;
+}
+
+constexpr ShapeCodes StaticShapeCodes = makeShapeCodes();
+// Pool shapes plus the extra orientations
+constexpr int ShapeCount = StaticShapeCodes.count;
+
+/*
+    Shape decoded at compile time.
+    cells hold the board index (y * BoardStride + x) of every block, from the lowest one.
+    placements hold the shape moved to every origin cell of the largest board, a placement
+    with origin (x, y) is legal on a board of width w when x + columns <= w and y + rows <= w.
+    rotateCw is the catalog index of the shape turned clockwise (itself when not rotatable),
+    orientations counts the different shapes met by turning it: 1, 2 or 4.
+*/
+struct ShapeInfo
+{
+    Bitboard mask;
+    int columns;
+    int rows;
+    int cellCount;
+    bool rotatable;
+    int rotateCw;
+    int orientations;
+    std::array<std::uint8_t, MaxShapeCells> cells;
+    std::array<Bitboard, BoardCells> placements;
+};
+
+constexpr ShapeInfo makeShapeInfo(int shape)
+{
+    int x, y, z;
+    ShapeInfo info {};
+
+    info.rotatable = (shape & ShapeRotateBit) != 0;
+    for(z = 0; z < 31; ++z)
+    {
+        if(((shape >> z) & 0x1) == 0)
+            continue;
+        x = z % StaticShapeStride;
+        y = z / StaticShapeStride;
+        info.columns = x + 1 > info.columns ? x + 1 : info.columns;
+        info.rows = y + 1 > info.rows ? y + 1 : info.rows;
+        info.cells[info.cellCount++] = static_cast<std::uint8_t>(y * BoardStride + x);
+        info.mask.set(y * BoardStride + x);
+    }
+    for(y = 0; y <= MaxBoardWidth - info.rows; ++y)
+    {
+        for(x = 0; x <= MaxBoardWidth - info.columns; ++x)
+            info.placements[y * BoardStride + x] = info.mask << (y * BoardStride + x);
+    }
+    return info;
+}
+
+constexpr int findShapeCode(int code)
+{
+    for(int x = 0; x < StaticShapeCodes.count; ++x)
+    {
+        if((StaticShapeCodes.codes[x] & ~ShapeRotateBit) == (code & ~ShapeRotateBit))
+            return x;
+    }
+    return -1;
+}
+
+constexpr std::array<ShapeInfo, ShapeCount> makeShapeCatalog()
+{
+    int x, y, z;
+    std::array<ShapeInfo, ShapeCount> catalog {};
+    for(x = 0; x < ShapeCount; ++x)
+    {
+        catalog[x] = makeShapeInfo(StaticShapeCodes.codes[x]);
+        catalog[x].rotateCw = catalog[x].rotatable ? findShapeCode(rotateStaticShape(StaticShapeCodes.codes[x])) : x;
+    }
+    for(x = 0; x < ShapeCount; ++x)
+    {
+        // turn until the shape comes back
+        for(y = catalog[x].rotateCw, z = 1; y != x && z < MaxRotations; y = catalog[y].rotateCw)
+            ++z;
+        catalog[x].orientations = z;
+    }
+    return catalog;
+}
+
+constexpr std::array<ShapeInfo, ShapeCount> ShapeCatalog = makeShapeCatalog();
+
+static_assert(ShapeCatalog[0].cellCount == 4 && ShapeCatalog[0].columns == 2 && ShapeCatalog[0].rows == 2, "square 2x2 is broken");
+static_assert(ShapeCatalog[19].cellCount == MaxShapeCells && ShapeCatalog[19].placements[BoardCells - 1].none(), "square 3x3 is broken");
+static_assert(ShapeCatalog[0].orientations == 1 && ShapeCatalog[1].orientations == 2 && ShapeCatalog[7].orientations == 4, "orientation closure is broken");
+static_assert(ShapeCatalog[ShapeCatalog[1].rotateCw].rows == 4, "line rotation is broken");
+
+constexpr const ShapeInfo &getShape(int idx)
+{
+    return ShapeCatalog[idx < 0 ? 0 : (idx >= ShapeCount ? ShapeCount - 1 : idx)];
+}
+
+// Catalog index of the shape turned clockwise turns times
+constexpr int rotateShape(int shape, int turns)
+{
+    for(turns &= MaxRotations - 1; turns > 0; --turns)
+        shape = getShape(shape).rotateCw;
+    return shape;
+}
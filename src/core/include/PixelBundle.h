@@ -0,0 +1,105 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/*
+    Sprite bundle, the images of the game decoded and filtered at build time by pixelblast_bundle.
+    Little-endian:
+
+        offset  size
+        0       4     magic "PBSB"
+        4       4     version
+        8       4     image count
+        12      4     block count
+        16      64*N  images: name (48, zero padded), width, height, stride in bytes, offset of the pixels
+        ...     60*M  blocks: name (48, zero padded), frame count, first frame image, first highlighted frame image
+        ...           pixels, every image on a BundleAlign boundary of the bundle
+
+    Pixels are premultiplied 0xAARRGGBB words (QImage::Format_ARGB32_Premultiplied) with the
+    brightness of the loader applied, so a QImage wraps them as they are: no PNG inflate, no
+    format conversion and no filter pass at startup. The frames of a block are consecutive images.
+*/
+
+constexpr char BundleMagic[4] = {'P', 'B', 'S', 'B'};
+constexpr int BundleVersion = 1;
+constexpr int BundleHeaderSize = 16;
+constexpr int BundleNameSize = 48;
+constexpr int BundleImageSize = BundleNameSize + 16;
+constexpr int BundleBlockSize = BundleNameSize + 12;
+constexpr std::size_t BundleAlign = 16;
+
+// Brightness of the grid cells and of the selected tray candidate, baked into the bundle
+constexpr int GridCellBrightness = 40;
+// Over the filtered cell
+constexpr int GridCellBrightBrightness = 70;
+constexpr int HighlightBrightness = 60;
+// Image of the bright grid cell, made from "grid-cell"
+constexpr const char *BundleGridCellBright = "grid-cell-bright";
+
+struct BundleImage
+{
+    std::string name;
+    int width = 0;
+    int height = 0;
+    int stride = 0;
+    // The pixels inside of the bundle data
+    const std::uint32_t *pixels = nullptr;
+};
+
+struct BundleBlock
+{
+    std::string name;
+    int frames = 0;
+    int image = 0;
+    int highlight = 0;
+};
+
+// Tables of a bundle in memory, the pixels stay where they are
+class SpriteBundle
+{
+public:
+    // data is 4-byte aligned and outlives the bundle; false leaves it empty when a table
+    // or an image is out of the size
+    bool open(const std::uint8_t *data, std::size_t size);
+    void clear();
+
+    int imageCount() const;
+    const BundleImage &image(int index) const;
+    // Index of the image, -1 when there is none
+    int findImage(const std::string &name) const;
+
+    int blockCount() const;
+    const BundleBlock &block(int index) const;
+
+private:
+    std::vector<BundleImage> _images;
+    std::vector<BundleBlock> _blocks;
+};
+
+class BundleWriter
+{
+public:
+    // Copy of the pixels, stride in bytes; returns the index of the image
+    int addImage(const std::string &name, int width, int height, const std::uint32_t *pixels, int stride);
+    void addBlock(const std::string &name, int frames, int image, int highlight);
+
+    int imageCount() const;
+
+    // Replace the file at path with a rename, never rewrite it in place
+    bool write(const char *path) const;
+
+private:
+    struct Entry
+    {
+        std::string name;
+        int width;
+        int height;
+        std::vector<std::uint32_t> pixels;
+    };
+
+    std::vector<Entry> _images;
+    std::vector<BundleBlock> _blocks;
+};
@@ -0,0 +1,216 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+#include "PixelBitboard.h"
+#include "PixelBlastShapes.h"
+#include "PixelRandom.h"
+
+/*
+    Rules of the game without any Qt dependency.
+    GameEngine owns a GameState and changes it only through applyMove(), so a game can be
+    played headless (simulations, solvers) or drawn by the PixelBlast widget.
+*/
+
+constexpr int MaxCandidates = 3;
+constexpr int DefaultColorCount = 8;
+
+enum class CandidateMode
+{
+    // Weighted shapes that can all be placed in some order. When no triplet of the pool fits the
+    // board the hand is dealt anyway, and the game is over
+    Selective,
+    // Three different shapes from the catalog
+    Random
+};
+
+// Relative chance of every catalog shape in the Selective mode
+struct CandidateWeights
+{
+    std::array<int, MaxShapes> shapes {};
+};
+
+// difficulty from -100 (mostly small shapes) through 0 (uniform) to 100 (mostly large shapes)
+constexpr CandidateWeights makeCandidateWeights(int difficulty)
+{
+    int x, weight;
+    CandidateWeights weights;
+    difficulty = difficulty < -100 ? -100 : (difficulty > 100 ? 100 : difficulty);
+    for(x = 0; x < MaxShapes; ++x)
+    {
+        // cell counts are 1 .. 9, a shape of 5 cells keeps the base weight
+        weight = 256 + difficulty * (getShape(x).cellCount - 5) * 64 / 100;
+        weights.shapes[x] = weight < 1 ? 1 : weight;
+    }
+    return weights;
+}
+
+struct Candidate
+{
+    // Catalog index, -1 when the candidate is already placed
+    int shape = -1;
+    int color = 0;
+};
+
+struct GameState
+{
+    // Board is width x width cells, see PixelBitboard.h for the cell layout
+    int width = DefaultBoardWidth;
+    Bitboard occupied {};
+    // Color of every occupied cell, cleared cells keep the last color
+    std::array<std::uint8_t, BoardCells> colors {};
+    std::array<Candidate, MaxCandidates> candidates {};
+    // Count of occupied cells in every row and column, a line is complete at width
+    std::array<std::uint8_t, MaxBoardWidth> rowFill {};
+    std::array<std::uint8_t, MaxBoardWidth> columnFill {};
+    int scores = 0;
+    int round = 0;
+    bool over = false;
+    // Rotation mode: a candidate may be placed in any of its orientations
+    bool rotation = false;
+};
+
+struct Move
+{
+    int candidate;
+    // Cell (y * BoardStride + x) of the top-left corner of the shape box
+    int cell;
+    // Clockwise turns of the candidate, 0 outside of the rotation mode
+    int rotation = 0;
+};
+
+// Everything the rules need to go on with a game, copied by value for undo and autosave.
+// Cell colors are left out: they only matter for drawing and would not fit in 64 bytes
+struct GameSnapshot
+{
+    Bitboard occupied;
+    // Pcg32 state, the candidates of the next rounds
+    std::uint64_t random;
+    // Seed of the game, seed() after a restore
+    std::uint64_t seed;
+    std::int32_t scores;
+    std::uint32_t round;
+    std::array<std::int8_t, MaxCandidates> shapes;
+    std::array<std::uint8_t, MaxCandidates> colors;
+    std::uint8_t width;
+    // SnapshotOver | SnapshotRotation
+    std::uint8_t flags;
+};
+
+constexpr std::uint8_t SnapshotOver = 0x1;
+constexpr std::uint8_t SnapshotRotation = 0x2;
+
+static_assert(sizeof(GameSnapshot) <= 64);
+
+struct MoveList
+{
+    int count = 0;
+    std::array<Move, MaxCandidates * MaxRotations * BoardCells> moves;
+};
+
+struct MoveResult
+{
+    bool placed = false;
+    // Cells taken by the shape
+    Bitboard cells {};
+    // Cells of the destroyed rows and columns
+    Bitboard cleared {};
+    int lines = 0;
+    int points = 0;
+};
+
+class GameEngine
+{
+public:
+    explicit GameEngine(CandidateMode mode = CandidateMode::Selective, int width = DefaultBoardWidth);
+
+    // New game from the seed set by setSeed(), or from the next seed of the chain
+    void reset();
+
+    // Seed of the next reset(), the same seed replays the same candidates and colors
+    void setSeed(std::uint64_t seed);
+    // Seed of the current game
+    std::uint64_t seed() const;
+
+    // Board width from MinBoardWidth to MaxBoardWidth, applied by the next reset()
+    void setBoardWidth(int width);
+    int boardWidth() const;
+
+    inline const GameState &state() const
+    {
+        return _state;
+    }
+
+    inline bool isOver() const
+    {
+        return _state.over;
+    }
+
+    void setColorCount(int count);
+    int colorCount() const;
+
+    void setCandidateMode(CandidateMode mode);
+    CandidateMode candidateMode() const;
+
+    // Rotation mode, applied by the next reset()
+    void setRotation(bool rotation);
+    bool rotation() const;
+
+    // Shape weights of the Selective mode, applied from the next round
+    void setCandidateWeights(const CandidateWeights &weights);
+    const CandidateWeights &candidateWeights() const;
+    // makeCandidateWeights(difficulty), the value replays record
+    void setDifficulty(int difficulty);
+    int difficulty() const;
+
+    bool isLegal(const Move &move) const;
+    void legalMoves(MoveList &list) const;
+    bool hasLegalMove() const;
+
+    // Place the candidate, clear filled lines, start the next round and detect the end of game
+    MoveResult applyMove(const Move &move);
+
+    GameSnapshot snapshot() const;
+    // Continue from the snapshot within the current game settings, the cell colors stay as they are.
+    // False leaves the state untouched when the snapshot is not valid: a shape out of the catalog
+    // or a candidate color out of colorCount()
+    bool restore(const GameSnapshot &snapshot);
+    // Set the colors of the cells in the order of Bitboard::takeFirst()
+    void recolor(Bitboard cells, const std::uint8_t *colors);
+
+    // Mask of the shape at cell, empty when the shape leaves the board
+    static Bitboard placementMask(int shape, int cell, int width);
+    static bool canTrigger(int shape, const Bitboard &grids, int width);
+    // Remove filled rows and columns, returns the removed cells
+    static Bitboard clearLines(Bitboard &grids, int width, int &lines);
+    // Orientations a candidate shape can be placed in: rotateShape(shape, 0 .. count - 1)
+    static int orientationCount(int shape, bool rotation);
+
+private:
+    void generateCandidates();
+    bool checkOver() const;
+    void fillCells(Bitboard cells, int color);
+    void removeCells(Bitboard cells);
+    int sampleShape();
+    // Weighted triplet among all the ones that fit the board in some order, false when there is none
+    bool sampleFittingTriplet(std::array<int, MaxCandidates> &candidates);
+    // Take the first free placement of the shape
+    static bool placeFirst(int shape, Bitboard &grids, int width);
+    // Some order of the remaining shapes fits the board, with the lines cleared between the moves.
+    // Every tried placement takes one of budget, false when it runs out
+    static bool placeAll(const Bitboard &grids, const std::array<int, MaxCandidates> &shapes, unsigned remaining, int width, bool rotation, int &budget);
+
+    CandidateMode _mode;
+    int _width;
+    int _colorCount;
+    bool _rotation;
+    int _difficulty;
+    CandidateWeights _weights;
+    // Running sums of _weights for the sampling
+    std::array<int, MaxShapes> _weightSums;
+    std::uint64_t _seed;
+    std::uint64_t _nextSeed;
+    GameState _state;
+    Pcg32 _random;
+};
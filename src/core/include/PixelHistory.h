@@ -0,0 +1,54 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+#include "PixelGameEngine.h"
+
+/*
+    Undo and redo of the placements, a ring of the last HistoryCapacity moves.
+    Every entry keeps the snapshot before its move and the colors of the cells the move covered,
+    so undo is two copies. Redo applies the move again from that snapshot: the generator state is
+    part of it, so the same candidates come back.
+*/
+
+constexpr int HistoryCapacity = 128;
+
+class GameHistory
+{
+public:
+    GameHistory();
+
+    void clear();
+
+    // Record the move before engine.applyMove(move), the moves undone before are dropped
+    void record(const GameEngine &engine, const Move &move);
+
+    bool canUndo() const;
+    bool canRedo() const;
+
+    // Back to the state before the last move
+    bool undo(GameEngine &engine);
+    // Apply the last undone move again
+    MoveResult redo(GameEngine &engine);
+
+private:
+    struct Entry
+    {
+        GameSnapshot before;
+        // Colors under the placed cells, a later undo shows the lines they covered again
+        std::array<std::uint8_t, MaxShapeCells> colors;
+        std::uint8_t candidate;
+        std::uint8_t cell;
+        std::uint8_t rotation;
+    };
+
+    Entry &entry(int index);
+    static Bitboard placedCells(const Entry &entry);
+
+    std::array<Entry, HistoryCapacity> _entries;
+    int _first;
+    int _count;
+    // Entries before this one can be undone, the rest redone
+    int _position;
+};
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+/*
+    Color filters over scanlines of premultiplied 0xAARRGGBB pixels (QImage::Format_ARGB32_Premultiplied).
+    The steps of a filter run in order on every pixel while it is in registers, so a pipeline
+    of several steps still reads and writes the line once. The kernels work on 16-bit lanes:
+    AVX2 with 8 pixels per step when the library is built with -DPB_AVX2=ON, SSE2 with 4 pixels
+    on every x86-64, and the scalar code for the tail and other targets. All of them give the
+    same bytes. The alpha channel is never changed and the colors never exceed it.
+*/
+
+constexpr int MaxFilterSteps = 8;
+
+enum class FilterKind : std::uint8_t
+{
+    Brightness,
+    Tint,
+    Desaturate
+};
+
+struct FilterStep
+{
+    FilterKind kind;
+    int amount;
+    std::uint32_t color;
+};
+
+class ImageFilter
+{
+public:
+    ImageFilter();
+
+    // Add amount -255..255 to the red, green and blue of every pixel
+    ImageFilter &brightness(int amount);
+    // Blend toward the 0xRRGGBB color, strength 0..255
+    ImageFilter &tint(std::uint32_t color, int strength);
+    // Blend toward the gray of the pixel, amount 0..255
+    ImageFilter &desaturate(int amount);
+
+    bool empty() const;
+    void clear();
+
+    // Filter count pixels in place
+    void apply(std::uint32_t *pixels, int count) const;
+
+    // The widest kernel apply() uses: "avx2", "sse2" or "scalar"
+    static const char *kernel();
+
+private:
+    void add(FilterKind kind, int amount, std::uint32_t color);
+
+    std::array<FilterStep, MaxFilterSteps> _steps;
+    int _count;
+};
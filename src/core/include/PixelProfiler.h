@@ -0,0 +1,96 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+
+/*
+    Frame time profiler of the widget, no Qt. Every frame is one sample of the time spent in
+    each phase; the last ProfileFrames samples are kept for the overlay and the CSV export.
+    Phases nest: a phase started inside another one pauses it, so the phases of a frame never
+    count the same nanosecond twice and their sum is the busy time of the frame.
+    A disabled profiler does not read the clock.
+*/
+
+enum class ProfilePhase : std::uint8_t
+{
+    Input,
+    Logic,
+    Sound,
+    // Logo, grid and empty cells: the static layer, or the finished frame of the composer thread
+    Grid,
+    Cells,
+    Destroy,
+    Tray,
+    Held,
+    Text,
+    Count
+};
+
+constexpr int ProfilePhaseCount = static_cast<int>(ProfilePhase::Count);
+constexpr int ProfileFrames = 240;
+constexpr int MaxProfileDepth = 8;
+
+struct ProfileSample
+{
+    // Time from the start of the frame to the start of the next one
+    std::int64_t interval;
+    std::array<std::int64_t, ProfilePhaseCount> phases;
+};
+
+class FrameProfiler
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    FrameProfiler();
+
+    void setEnabled(bool value);
+    bool enabled() const;
+
+    // Close the sample of the last frame and start a new one
+    void beginFrame();
+
+    void push(ProfilePhase phase);
+    void pop();
+
+    // Samples of the closed frames, age 0 is the last one
+    int sampleCount() const;
+    const ProfileSample &sample(int age) const;
+    // Nanoseconds over the kept samples
+    std::int64_t average(ProfilePhase phase) const;
+    std::int64_t maximum(ProfilePhase phase) const;
+
+    // One row per kept frame, the oldest first, times in milliseconds
+    bool writeCsv(const char *path) const;
+
+    static const char *phaseName(ProfilePhase phase);
+
+private:
+    void account(Clock::time_point now);
+
+    bool _enabled;
+    std::array<ProfileSample, ProfileFrames> _samples;
+    // Index of the next sample, the one being filled
+    int _next;
+    int _count;
+    std::uint64_t _frames;
+    Clock::time_point _frameStart;
+
+    std::array<ProfilePhase, MaxProfileDepth> _stack;
+    int _depth;
+    Clock::time_point _phaseStart;
+};
+
+// Time of the scope in a phase, next() switches to another phase
+class ProfileScope
+{
+public:
+    ProfileScope(FrameProfiler *profiler, ProfilePhase phase);
+    ~ProfileScope();
+
+    void next(ProfilePhase phase);
+
+private:
+    FrameProfiler *_profiler;
+};
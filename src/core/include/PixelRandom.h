@@ -0,0 +1,106 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+
+/*
+    PCG32 (XSH RR 64/32) with a fixed stream: 8 bytes of state, a few cycles per number.
+    Every game owns one, seeded from the game seed, so a game is replayed exactly from its seed
+    and parallel games never share a generator. bounded() and shuffle() are part of the type,
+    so the sequence does not depend on the standard library distributions either.
+*/
+
+class Pcg32
+{
+public:
+    using result_type = std::uint32_t;
+
+    constexpr explicit Pcg32(std::uint64_t seed = 0) : _state(0)
+    {
+        this->seed(seed);
+    }
+
+    constexpr void seed(std::uint64_t seed)
+    {
+        _state = 0;
+        next();
+        _state += seed;
+        next();
+    }
+
+    static constexpr result_type min()
+    {
+        return 0;
+    }
+
+    static constexpr result_type max()
+    {
+        return std::numeric_limits<result_type>::max();
+    }
+
+    constexpr result_type operator()()
+    {
+        return next();
+    }
+
+    // Uniform number in [0, bound), bound > 0
+    constexpr std::uint32_t bounded(std::uint32_t bound)
+    {
+        std::uint32_t threshold = (0U - bound) % bound;
+        std::uint32_t value;
+        // rejecting the low values removes the modulo bias
+        do
+        {
+            value = next();
+        } while(value < threshold);
+        return value % bound;
+    }
+
+    template <typename It>
+    constexpr void shuffle(It first, It last)
+    {
+        std::uint32_t x, y;
+        for(x = static_cast<std::uint32_t>(last - first); x > 1; --x)
+        {
+            y = bounded(x);
+            auto tmp = first[x - 1];
+            first[x - 1] = first[y];
+            first[y] = tmp;
+        }
+    }
+
+    constexpr std::uint64_t state() const
+    {
+        return _state;
+    }
+
+    constexpr void setState(std::uint64_t state)
+    {
+        _state = state;
+    }
+
+private:
+    static constexpr std::uint64_t Multiplier = 6364136223846793005ULL;
+    static constexpr std::uint64_t Increment = 1442695040888963407ULL;
+
+    constexpr std::uint32_t next()
+    {
+        std::uint64_t old = _state;
+        std::uint32_t shifted, rotation;
+        _state = old * Multiplier + Increment;
+        shifted = static_cast<std::uint32_t>(((old >> 18) ^ old) >> 27);
+        rotation = static_cast<std::uint32_t>(old >> 59);
+        return (shifted >> rotation) | (shifted << ((0U - rotation) & 31));
+    }
+
+    std::uint64_t _state;
+};
+
+// splitmix64 step, spreads a counter or a user seed over all 64 bits
+constexpr std::uint64_t mixSeed(std::uint64_t value)
+{
+    value += 0x9E3779B97F4A7C15ULL;
+    value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    value = (value ^ (value >> 27)) * 0x94D049BB133111EBULL;
+    return value ^ (value >> 31);
+}
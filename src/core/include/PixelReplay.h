@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+#include "PixelGameEngine.h"
+
+/*
+    Replay stream, little-endian:
+
+        offset  size
+        0       4     magic "PBRP"
+        4       1     version
+        5       1     board width
+        6       1     candidate mode, 0 Selective, 1 Random
+        7       1     color count
+        8       1     difficulty, signed
+        9       1     flags, bit 0 rotation mode
+        10      2     reserved, zero
+        12      8     game seed
+        20      2*N   records: candidate byte (bits 0-1 slot, 2-3 clockwise turns), cell byte
+
+    The seed rebuilds every candidate and color, so one placement is all a move needs:
+    a game of a few hundred moves takes well under a kilobyte. Records are appended while
+    the game runs, a cut stream still replays up to its last whole record.
+*/
+
+constexpr char ReplayMagic[4] = {'P', 'B', 'R', 'P'};
+constexpr int ReplayVersion = 1;
+constexpr int ReplayHeaderSize = 20;
+constexpr int ReplayRecordSize = 2;
+
+struct ReplayHeader
+{
+    int version = ReplayVersion;
+    int width = DefaultBoardWidth;
+    CandidateMode mode = CandidateMode::Selective;
+    int colorCount = DefaultColorCount;
+    int difficulty = 0;
+    bool rotation = false;
+    std::uint64_t seed = 0;
+};
+
+struct Replay
+{
+    ReplayHeader header;
+    std::vector<Move> moves;
+};
+
+// Header of the game the engine plays now
+ReplayHeader replayHeader(const GameEngine &engine);
+
+void encodeReplayHeader(const ReplayHeader &header, std::uint8_t *out);
+// ReplayHeaderSize bytes, false when they are not a header of this version
+bool decodeReplayHeader(const std::uint8_t *data, ReplayHeader &header);
+bool decodeReplay(const std::uint8_t *data, std::size_t size, Replay &replay);
+bool loadReplay(const char *path, Replay &replay);
+
+// Configure the engine from the header and start the recorded game
+void startReplay(GameEngine &engine, const ReplayHeader &header);
+// Start the game and apply its first count moves (-1 all) without drawing,
+// returns the moves applied, less than asked when a record is not legal
+int replayMoves(GameEngine &engine, const Replay &replay, int count = -1);
+
+class ReplayWriter
+{
+public:
+    ReplayWriter() = default;
+    ReplayWriter(const ReplayWriter &) = delete;
+    ReplayWriter &operator=(const ReplayWriter &) = delete;
+    ~ReplayWriter();
+
+    // Truncate the file and write the header
+    bool open(const char *path, const ReplayHeader &header);
+    // Append one record and flush it, so a crash keeps the game so far
+    bool append(const Move &move);
+    void close();
+
+    bool isOpen() const;
+
+private:
+    std::FILE *_file = nullptr;
+};
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+#include "PixelGameEngine.h"
+
+/*
+    Search over every order and position of the remaining candidates, with the line clears
+    between the moves. Boards are Zobrist hashed together with the remaining candidates, so a
+    position reached by different orders is evaluated once through the transposition table.
+    The table is kept between calls: values only depend on the board and the candidates left.
+*/
+
+// Value of a line cleared on the way, a leaf adds evaluateBoard()
+constexpr int SolverLineValue = 100;
+// Value of every candidate that can not be placed
+constexpr int SolverDeadEnd = -100000;
+
+struct SolverResult
+{
+    // Best order found, count is less than the candidates left when they can not all be placed
+    int count = 0;
+    std::array<Move, MaxCandidates> moves {};
+    int value = SolverDeadEnd * MaxCandidates;
+    // The whole tree was searched in the budget
+    bool complete = false;
+    // Proven: the remaining candidates can not be placed in any order
+    bool doomed = false;
+    std::uint64_t nodes = 0;
+};
+
+// Higher is better: closed holes and one cell wide gaps are penalized
+int evaluateBoard(const Bitboard &grids, int width);
+
+std::uint64_t zobristHash(const Bitboard &grids);
+
+class GameSolver
+{
+public:
+    // Transposition table of (1 << tableBits) entries
+    explicit GameSolver(int tableBits = 15);
+
+    SolverResult solve(const GameState &state, std::chrono::microseconds budget = std::chrono::microseconds(2000));
+
+    // Stop after this many nodes instead of the time budget, 0 goes back to the budget. With a
+    // node limit and a cleared table the result depends on the state only, not on the machine
+    void setNodeLimit(std::uint64_t nodes);
+    void clearTable();
+
+private:
+    struct Entry
+    {
+        std::uint64_t key;
+        int value;
+        std::uint8_t count;
+        // rotation << 10 | candidate << 8 | cell
+        std::array<std::uint16_t, MaxCandidates> moves;
+    };
+
+    // A first move with the board after it, ordered before the search
+    struct RootMove
+    {
+        Move move;
+        Bitboard grids;
+        std::uint64_t hash;
+        int lines;
+        int order;
+    };
+
+    int search(const Bitboard &grids, std::uint64_t hash, unsigned remaining, int depth);
+    std::uint64_t remainingKey(unsigned remaining) const;
+    void timeCheck();
+
+    int _width;
+    bool _rotation;
+    bool _stopped;
+    std::uint64_t _nodes;
+    std::uint64_t _nodeLimit;
+    std::chrono::steady_clock::time_point _deadline;
+    std::array<int, MaxCandidates> _shapes;
+    // Principal line of every depth
+    std::array<std::array<Move, MaxCandidates>, MaxCandidates + 1> _lines;
+    std::array<int, MaxCandidates + 1> _lineCounts;
+    std::vector<Entry> _table;
+    // Reused by every solve()
+    std::vector<RootMove> _roots;
+};
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstdint>
+
+/*
+    Trace events for chrome://tracing and ui.perfetto.dev. Configured with -DPB_TRACE=ON the
+    macros record to a ring buffer of the calling thread, otherwise they compile to nothing.
+    A buffer keeps the last TraceBufferEvents events of its thread and outlives the thread;
+    writeTrace() puts every buffer into one Chrome trace JSON file.
+
+    Names are kept as pointers: pass string literals only.
+
+        PB_TRACE_SCOPE("prepareResources");          complete event of the enclosing scope
+        PB_TRACE_BEGIN("network.stats", reply);      async span, ended by PB_TRACE_END with the same id
+        PB_TRACE_INSTANT("first frame");             point in time
+        PB_TRACE_THREAD("FrameComposer");            name of the calling thread in the viewer
+*/
+
+constexpr int TraceBufferEvents = 8192;
+
+bool traceEnabled();
+
+void traceComplete(const char *name, std::int64_t start, std::int64_t end);
+void traceAsync(const char *name, char phase, std::uint64_t id);
+void traceInstant(const char *name);
+void traceThreadName(const char *name);
+// Nanoseconds since the start of the trace
+std::int64_t traceNow();
+
+// Write the events of every thread, false when tracing is off or the file can not be written
+bool writeTrace(const char *path);
+
+// Id of an async span: a number or the address of the object the span belongs to
+inline std::uint64_t traceId(std::uint64_t id)
+{
+    return id;
+}
+
+template <typename T>
+inline std::uint64_t traceId(const T *object)
+{
+    return static_cast<std::uint64_t>(reinterpret_cast<std::uintptr_t>(object));
+}
+
+class TraceScope
+{
+public:
+    explicit TraceScope(const char *name) : _name(name), _start(traceNow())
+    {
+    }
+
+    ~TraceScope()
+    {
+        traceComplete(_name, _start, traceNow());
+    }
+
+private:
+    const char *_name;
+    std::int64_t _start;
+};
+
+#ifdef PB_TRACE
+#define PB_TRACE_CONCAT_(a, b) a##b
+#define PB_TRACE_CONCAT(a, b) PB_TRACE_CONCAT_(a, b)
+#define PB_TRACE_SCOPE(name) TraceScope PB_TRACE_CONCAT(pbTraceScope, __LINE__)(name)
+#define PB_TRACE_BEGIN(name, id) traceAsync(name, 'b', traceId(id))
+#define PB_TRACE_END(name, id) traceAsync(name, 'e', traceId(id))
+#define PB_TRACE_INSTANT(name) traceInstant(name)
+#define PB_TRACE_THREAD(name) traceThreadName(name)
+#else
+#define PB_TRACE_SCOPE(name) ((void)0)
+#define PB_TRACE_BEGIN(name, id) ((void)0)
+#define PB_TRACE_END(name, id) ((void)0)
+#define PB_TRACE_INSTANT(name) ((void)0)
+#define PB_TRACE_THREAD(name) ((void)0)
+#endif
@@ -3,12 +3,27 @@
 #include <utility>
 #include <memory>
 
+#include <QFile>
+#include <QBrush>
+#include <QColor>
+#include <QFont>
+#include <QImage>
 #include <QList>
 #include <QPixmap>
 #include <QTimer>
 #include <QWidget>
+#include <QWindow>
+#include <QElapsedTimer>
 
 #include "PixelBegin.h"
+#include "PixelAutosave.h"
+#include "PixelGameEngine.h"
+#include "PixelHistory.h"
+#include "PixelImageFilter.h"
+#include "PixelProfiler.h"
+#include "PixelReplay.h"
+#include "PixelSolver.h"
+#include "PixelSpriteAtlas.h"
 
 struct PB_EXPORT BlockObject
 {
@@ -16,43 +31,144 @@ struct PB_EXPORT BlockObject
     int y;
     int idx;
 
-    BlockObject(int x, int y, int idx = -1) : x(x), y(y), idx(idx)
+    BlockObject(int x = 0, int y = 0, int idx = -1) : x(x), y(y), idx(idx)
     {
     }
 
     QPointF adjustPoint(const QPointF &adjust, const QSizeF &scale) const;
 };
 
+// Value type with fixed storage, candidates move between the tray and the cursor by copy
 struct ShapeBlock
 {
-    int shapeColor;
-    int rows;
-    int columns;
-    QList<std::uint8_t> rawBlocks;
-    QList<BlockObject> blocks;
+    // Catalog index of the shown orientation, -1 for an empty slot
+    int shape = -1;
+    // Clockwise turns from the dealt candidate
+    int rotation = 0;
+    int shapeColor = 0;
+    int rows = 0;
+    int columns = 0;
+    int count = 0;
+    std::array<BlockObject, MaxShapeCells> blocks;
+
+    inline bool empty() const
+    {
+        return shape == -1;
+    }
+};
+
+struct DestroyBlock
+{
+    BlockObject block;
+    int color;
+};
+
+// What the last frame showed of the parts that change without a move, see PixelBlast::updateDirty()
+struct DrawnScene
+{
+    QRect held;
+    int heldShape = -1;
+    // Occupied cell under the cursor, it is animated
+    int hoverCell = -1;
+    Bitboard hover {};
+    Bitboard hint {};
+    std::array<int, MaxCandidates> tray {-1, -1, -1};
+    int traySelected = -1;
+    int trayHint = -1;
+    QRect praise;
+    int frameIndex = -1;
+    // The hovered block plays its hoverFrames frames once from hoverStart, then the loop may sleep
+    int hoverStart = 0;
+    int hoverFrames = 0;
+};
+
+// Everything one frame shows, copied from the widget: the composer thread draws it while the game goes on
+struct FrameSnapshot
+{
+    QSize size;
+    qreal ratio = 1.0;
+    QRectF boardRegion;
+    QSizeF scaleFactor;
+    int cellSquare = DefaultBoardWidth;
+    float heightOffsetCandidates = 0;
+    QPoint mousePoint;
+    Bitboard occupied {};
+    Bitboard hover {};
+    // Hint cells, empty while a shape is dragged
+    Bitboard hint {};
+    std::array<std::uint8_t, BoardCells> colors {};
+    // Occupied cell under the cursor, drawn larger, -1 without
+    int hoverCell = -1;
+    int frameIndex = 0;
+    float destroyScaler = 0;
+    // Only the first destroyCount blocks are copied
+    int destroyCount = 0;
+    std::array<DestroyBlock, BoardCells> destroyBlocks;
+    std::array<ShapeBlock, MaxCandidates> tray;
+    int traySelected = -1;
+    int trayHint = -1;
+    ShapeBlock held;
+    bool doomed = false;
+    bool replaying = false;
+    QString scoreText;
+    QString replayText;
+};
+
+// Fonts and texts of the frame, the same for the whole game
+struct FrameStyle
+{
+    QFont font;
+    QColor textColor;
+    QFont praiseFont;
+    QFont warningFont;
+    QString praise;
+    QString doomed;
+};
+
+// Images of the static layer, usable on any thread
+struct StaticSources
+{
+    QBrush window;
+    QImage logo;
+    QImage gridBorder;
+    QImage gridBackground;
+    QImage gridBackgroundBg;
 };
 
 struct BlockResource
 {
     QString name;
-    QList<QPixmap> resources;
+    // The frames are drawn from the atlas only
+    int frames = 0;
+    // Atlas sprite of the first frame, the frames follow it
+    int sprite = 0;
+    // Atlas sprite of the first brightened frame, the selected candidate of the tray
+    int highlight = 0;
 };
 
+// The images wrap the bundle where it is, a pixmap is made by the code that shows one
 struct PGlobalResources
 {
-    std::shared_ptr<QPixmap> gameLogo {};
-    std::shared_ptr<QPixmap> gridCell {};
-    std::shared_ptr<QPixmap> gridCellBright {};
-    std::shared_ptr<QPixmap> backgroundPix {};
-    std::shared_ptr<QPixmap> cursorPix {};
-    std::shared_ptr<QPixmap> gridBackgroundBorder {};
-    std::shared_ptr<QPixmap> gridBackground {};
-    std::shared_ptr<QPixmap> gridBackgroundBg {};
-    std::shared_ptr<QPixmap> uiTopHeader {};
+    QImage gameLogo;
+    QImage gridCell;
+    QImage gridCellBright;
+    QImage background;
+    QImage cursor;
+    QImage gridBackgroundBorder;
+    QImage gridBackground;
+    QImage gridBackgroundBg;
+    QImage uiTopHeader;
     std::shared_ptr<QList<BlockResource>> BlockRes {};
+    std::shared_ptr<StaticSources> staticSources {};
+    // Grid cells and every block frame, see SpriteGridCell
+    std::shared_ptr<SpriteAtlas> atlas {};
     std::shared_ptr<SoundManager> soundManager {};
+    // Mapped pack the images wrap, empty for the bundle linked into the game, released with the resources
+    std::shared_ptr<void> storage {};
 };
 
+class FrameComposer;
+
 class PB_EXPORT PixelBlast : public QWidget
 {
     Q_OBJECT
@@ -64,7 +180,21 @@ public:
     void stopGame();
     void resetGame();
 
+    // Board of size x size cells, one of BoardSizes, starts a new game
+    void setBoardSize(int size);
+    int boardSize();
+
+    // Held shapes turn with R or the mouse wheel, starts a new game
+    void setRotation(bool value);
+    bool rotation();
+
     bool isPlaying();
+    // The images and sounds are decoded, the game is drawn and the frame loop runs from here on
+    bool isLoaded();
+
+    // Compose the frames into images on a worker thread, paintEvent only blits the last one
+    void setThreadedRendering(bool value);
+    bool threadedRendering();
 
     inline int getFrames()
     {
@@ -73,14 +203,42 @@ public:
 
     inline int getScores()
     {
-        return scores;
+        return engine.state().scores;
     }
 
+    // Every new game is recorded to a file of this directory, empty turns the recording off
+    void setReplayDirectory(const QString &path);
+    // F4 writes the frames of the profiler overlay (F3) to a CSV file of this directory
+    void setProfileDirectory(const QString &path);
+    // Animated playback of a recorded game, Left/Right step through it, Escape starts a new game
+    bool playReplay(const QString &path);
+    void seekReplay(int position);
+    bool isReplaying();
+
+    // Seed of the next game, the current game keeps its seed
+    void setSeed(std::uint64_t seed);
+    std::uint64_t seed();
+
+    // Every move is saved to this file, resumeGame() continues the game saved there before
+    void setAutosaveFile(const QString &path);
+    bool resumeGame();
+
+    // Placements of the current game, Ctrl+Z and Ctrl+Y
+    bool undoMove();
+    bool redoMove();
+
 signals:
     void endOfGame();
+    // The score or the game changed, the owner updates its texts instead of polling
+    void scoresChanged(int scores);
+    // Emitted once, the owner shows the widget instead of its loading page; a pack loaded
+    // later only changes the sprites
+    void resourcesReady();
 
 private slots:
     void updateScene();
+    void resourcesLoaded();
+    void windowVisibilityChanged(QWindow::Visibility visibility);
 
     // void receiveCurrent(const PixelStats &stat, bool ok);
     // void receiveStats(const QList<PixelStats> &stats, bool ok);
@@ -88,23 +246,60 @@ private slots:
 private:
     void mousePressEvent(QMouseEvent *event) override;
     void mouseReleaseEvent(QMouseEvent *event) override;
+    void mouseMoveEvent(QMouseEvent *event) override;
+    void leaveEvent(QEvent *event) override;
+    void showEvent(QShowEvent *event) override;
+    void hideEvent(QHideEvent *event) override;
+    void keyPressEvent(QKeyEvent *event) override;
+    void wheelEvent(QWheelEvent *event) override;
     void paintEvent(QPaintEvent *event) override;
     void resizeEvent(QResizeEvent *event) override;
 
     void updateData();
-    bool canTrigger(const QList<std::uint8_t> &blocks, QList<std::uint8_t> &grids, bool placeTo = false);
-    void generateCandidates(bool randomOnly);
-    void assignBlocks(const QList<std::uint8_t> &blocks, ShapeBlock &assignTo);
-    QList<std::uint8_t> createBlocks(int shape);
+    // Run the frame loop at the refresh rate of the screen, a game that is idle or hidden does not start it
+    void wakeLoop();
+    // Something moves on the scene: an animation, a playback or the dragged shape
+    bool animating() const;
+    // Game ticks since the last frame
+    int advanceTicks();
+    // Draw everything that only changes with the widget size into staticLayer
+    void renderStaticLayer(const FrameSnapshot &frame);
+    // Repaint the parts of the scene that changed since the last frame, nothing when it is idle
+    void updateDirty();
+    // Mark a part of the widget to be drawn again, with the composer the next frame is sent to it
+    void invalidate(const QRect &rect);
+    void snapshot(FrameSnapshot &frame) const;
+    void submitFrame();
+    QRect cellRect(int cell) const;
+    QRect trayRect(int slot) const;
+    QRect heldRect() const;
+    QRect praiseRect(float scale) const;
+    void updateTexts();
+    void resetView();
+    void openRecorder();
+    void saveGame();
+    // Apply the move with sounds and effects, the only way a move reaches the engine
+    MoveResult placeMove(const Move &move);
+    void syncCandidates();
+    void assignBlocks(const Candidate &candidate, ShapeBlock &assignTo, int rotation = 0);
+    // Turn the held shape clockwise (1) or back (-1), rotation mode only
+    void rotateHeld(int turns);
+    // Highlight the first move of the best sequence
+    void showHint();
+    void checkDoomed();
+    // Sounds go through here, the profiler counts them
+    void playSound(const QString &name, qreal volume);
+    void exportProfile();
+    QRect profilerRect() const;
+    // Frame time graph and the phase averages, top left, drawn over the frame
+    void drawProfiler(QPainter &p);
 
     float heightOffsetCandidates = 30;
 
     int cellSquare;
     int mouseBtn;
-    int scores;
     int frames;
     int frameIndex;
-    int round;
     int lastSelectedBlock;
 
     bool mouseDownMode;
@@ -116,17 +311,75 @@ private:
     QSizeF scaleFactor;
     QRectF boardRegion;
     QTimer updateTimer;
-    QList<std::uint8_t> grid;
+    // Game time: the animations advance in ticks of 60 per second whatever the frame rate
+    QElapsedTimer clock;
+    qint64 tickTime;
+    bool playing;
+    // Background, logo, grid and empty cells, one blit per frame. Null until the next paintEvent after a resize
+    QPixmap staticLayer;
+
+    GameEngine engine;
+    // Preview of the dragged shape
+    Bitboard gridHover;
+
+    Pcg32 effects;
+    GameSolver solver;
+    // Cells and candidate of the hinted move, -1 without a hint
+    Bitboard gridHint;
+    int hintCandidate;
+    // The candidates left can not be placed in any order
+    bool doomed;
+
+    QString replayDirectory;
+    ReplayWriter recorder;
+    Replay replay;
+    // Game settings to restore after the playback
+    ReplayHeader gameSettings;
+    int replayPosition;
+    bool replaying;
+    // The game replays from its seed: it was not resumed and no move was undone
+    bool recordable;
+
+    GameHistory history;
+    QFile autosaveFile;
+    // Mapping of autosaveFile, nullptr when the game is not saved
+    uchar *autosaveData;
+    std::uint32_t autosaveSequence;
 
     QList<PixelStats> _onlineStats;
 
     float destroyScaler;
-    QList<std::pair<BlockObject, int>> destroyBlocks;
+    // A move clears at most the whole board
+    int destroyCount;
+    std::array<DestroyBlock, BoardCells> destroyBlocks;
 
     int shapeCandidateIdx;
-    std::array<std::shared_ptr<ShapeBlock>, 3> shapeCandidates;
+    std::array<ShapeBlock, MaxCandidates> shapeCandidates;
+
+    ShapeBlock currentShape;
+
+    // Texts drawn every frame, rebuilt by updateTexts() when a move changes them
+    QString scoreText;
+    QString replayText;
+    FrameStyle style;
+    // Bounds of TextPraise around its baseline origin
+    QRectF praiseBounds;
+
+    DrawnScene drawn;
+    // Worker thread of the threaded rendering, nullptr draws in paintEvent
+    FrameComposer *composer;
+    // Set by setThreadedRendering(), the composer is made with the resources
+    bool threaded;
+    // A part of the scene changed since the last frame sent to the composer
+    bool frameDirty;
+
+    FrameProfiler profiler;
+    QString profileDirectory;
 
-    std::shared_ptr<ShapeBlock> currentShape;
+    // Heap allocations seen by the frame loop, counted with PB_ALLOC_TRACE only
+    std::uint64_t allocationMark;
+    std::uint64_t allocationMax;
 
+    // nullptr until the resource loader is done
     std::shared_ptr<PGlobalResources> _res;
 };
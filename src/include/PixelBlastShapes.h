@@ -1,181 +0,0 @@
-#pragma once
-
-/* THE BIT (1 << 31) has Rotate state */
-
-const static int StaticShapes[] = {
-    // --- SQUARE ---
-    /*
-        # # . . .
-        # # . . .
-        . . . . .
-    */
-    0x0303 | (1 << 31),
-
-    // --- LINE I ---
-    /*
-        # # # # .
-        . . . . .
-        . . . . .
-    */
-    0x0F | (1 << 31),
-    /*
-        # . . . .
-        # . . . .
-        # . . . .
-        # . . . .
-    */
-    0x01010101 | (1 << 31),
-
-    // --- ZETA (Z) ---
-    /*
-        . # # . .
-        # # . . .
-        . . . . .
-    */
-    0x0603 | (1 << 31),
-    /*
-        # . . . .
-        # # . . .
-        . # . . .
-    */
-    0x020301 | (1 << 31),
-
-    // --- S-SHAPE ---
-    /*
-        # # . . .
-        . # # . .
-        . . . . .
-    */
-    0x0306 | (1 << 31),
-    /*
-        . # . . .
-        # # . . .
-        # . . . .
-    */
-    0x010302 | (1 << 31),
-
-    // --- T-SHAPE ---
-    /*
-        . # . . .
-        # # # . .
-        . . . . .
-    */
-    0x0207 | (1 << 31),
-    /*
-        # . . . .
-        # # . . .
-        # . . . .
-    */
-    0x010301 | (1 << 31),
-    /*
-        # # # . .
-        . # . . .
-        . . . . .
-    */
-    0x0702 | (1 << 31),
-    /*
-        . # . . .
-        # # . . .
-        . # . . .
-    */
-    0x020302 | (1 << 31),
-
-    // --- L-SHAPE ---
-    /*
-        # . . . .
-        # # # . .
-        . . . . .
-    */
-    0x0107 | (1 << 31),
-    /*
-        # # . . .
-        # . . . .
-        # . . . .
-    */
-    0x030101 | (1 << 31),
-    /*
-        # # # . .
-        . . # . .
-        . . . . .
-    */
-    0x0704 | (1 << 31),
-    /*
-        . # . . .
-        . # . . .
-        # # . . .
-    */
-    0x020203 | (1 << 31),
-
-    // --- J-SHAPE ---
-    /*
-        . . # . .
-        # # # . .
-        . . . . .
-    */
-    0x0407 | (1 << 31),
-    /*
-        # . . . .
-        # . . . .
-        # # . . .
-    */
-    0x010103 | (1 << 31),
-    /*
-        # # # . .
-        # . . . .
-        . . . . .
-    */
-    0x0701 | (1 << 31),
-    /*
-        # # . . .
-        . # . . .
-        . # . . .
-    */
-    0x030202 | (1 << 31),
-    /*
-        # # # . .
-        # # # . .
-        # # # . .
-    */
-    0x70707,
-    /*
-        # . . . .
-        . . . . .
-        . . . . .
-    */
-    0x1,
-    /*
-        # # . . .
-        . . . . .
-        . . . . .
-    */
-    0x3 | (1 << 31),
-    /*
-        # . . . .
-        # . . . .
-        . . . . .
-    */
-    0x101 | (1 << 31),
-    /*
-        # # . . .
-        # . . . .
-        . . . . .
-    */
-    0x103 | (1 << 31),
-    /*
-        # . . . .
-        # # . . .
-        . . . . .
-    */
-    0x301 | (1 << 31)};
-
-constexpr int MaxShapes = sizeof(StaticShapes) / sizeof(StaticShapes[0]);
-
-int getShape(int idx)
-{
-    return StaticShapes[qBound<int>(0, idx, MaxShapes - 1)];
-}
-
-inline int randomShapes()
-{
-    return getShape(QRandomGenerator::global()->bounded(0, MaxShapes));
-}
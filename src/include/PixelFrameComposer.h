@@ -0,0 +1,73 @@
+#pragma once
+
+#include <array>
+#include <memory>
+
+#include <QImage>
+#include <QMutex>
+#include <QObject>
+#include <QPainter>
+#include <QThread>
+#include <QWaitCondition>
+
+#include "PixelBlastGame.h"
+
+/*
+    Threaded rendering: the widget sends a FrameSnapshot after every frame that changed something,
+    the worker thread draws it into one of two images and the paintEvent of the widget blits the
+    last finished one. Snapshots sent while the worker is busy replace each other, a slow machine
+    shows fewer frames but the game loop never waits for the drawing.
+*/
+
+// Atlas sprites of the grid, the block frames follow them
+constexpr int SpriteGridCell = 0;
+constexpr int SpriteGridCellBright = 1;
+
+// Background, logo, grid and the empty cells of the board
+void drawStaticLayer(QPainter &painter, const FrameSnapshot &frame, const StaticSources &sources, SpriteAtlas &atlas);
+// Everything over the static layer, the layers are timed when a profiler is given
+void composeFrame(QPainter &painter, const FrameSnapshot &frame, SpriteAtlas &atlas, const FrameStyle &style, const PGlobalResources &res, FrameProfiler *profiler = nullptr);
+
+class PB_EXPORT FrameComposer : public QObject
+{
+    Q_OBJECT
+public:
+    FrameComposer(const FrameStyle &style, std::shared_ptr<PGlobalResources> res, QObject *parent = nullptr);
+    ~FrameComposer();
+
+    // Copy the frame for the worker, it draws the last one sent
+    void submit(const FrameSnapshot &frame);
+    // Draw the last finished frame, false before the first one
+    bool present(QPainter &painter);
+
+signals:
+    // Emitted on the worker thread
+    void frameReady();
+
+private:
+    void run();
+    void compose();
+
+    FrameStyle m_style;
+    std::shared_ptr<PGlobalResources> m_res;
+    std::unique_ptr<QThread> m_thread;
+
+    // m_pending, m_scheduled and m_stop
+    QMutex m_pendingMutex;
+    QWaitCondition m_wake;
+    FrameSnapshot m_pending;
+    bool m_scheduled = false;
+    bool m_stop = false;
+
+    // Worker state
+    FrameSnapshot m_frame;
+    SpriteAtlas m_atlas {true};
+    QImage m_staticLayer;
+    QRectF m_staticBoard;
+    int m_staticCells = 0;
+
+    // The buffer m_ready is shown, the worker draws into the other one
+    QMutex m_bufferMutex;
+    std::array<QImage, 2> m_buffers;
+    int m_ready = -1;
+};
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include <QFileSystemWatcher>
+#include <QImage>
+#include <QList>
+#include <QObject>
+#include <QThreadPool>
+#include <QTimer>
+
+#include "PixelBlastGame.h"
+#include "PixelBundle.h"
+#include "PixelImageFilter.h"
+
+/*
+    Startup loading of the game resources. The sprite bundle made by the build (PixelBundle.h)
+    is linked in as an aligned array and wrapped in QImages as it is. Without a valid one blocks.cfg is read at once, so the number of block
+    colors is known before the first game, and the PNGs are decoded into QImages and filtered in
+    parallel on a thread pool. Either way the sprite atlas is drawn on the pool, then the GUI
+    thread puts the images, the atlas and the static sources together, registers the sounds and
+    emits ready(). resources() is nullptr until then.
+
+    Only the atlas is a copy of the sprites. The other images keep wrapping the bundle and a
+    pixmap is made by the code that shows one.
+
+    A resource pack is a bundle file on disk, made by pixelblast_bundle from the qrc of a theme.
+    It is memory-mapped and wrapped the same way: a page is read from the disk by the pool when
+    the atlas is drawn, or when an image is first drawn, and the mapping is released with the
+    last resources made from it. The file is watched and loaded again when it changes; the shown
+    resources stay until the new atlas is ready. A pack is replaced by a rename (BundleWriter
+    does), written over in place it would truncate the pages under the shown images. Sounds are
+    not part of a pack.
+*/
+
+class PB_EXPORT ResourceLoader : public QObject
+{
+    Q_OBJECT
+public:
+    // Shared by every widget of the process, the loading starts with the first call
+    static ResourceLoader *instance();
+
+    bool isReady() const;
+    std::shared_ptr<PGlobalResources> resources() const;
+    // Block colors of blocks.cfg, known before the images are decoded
+    int colorCount() const;
+
+    // Sprites of a pack file, empty goes back to the ones of the library. A pack that can not
+    // be loaded keeps the resources shown now
+    void setPack(const QString &path);
+    QString pack() const;
+
+signals:
+    // The first resources, then every pack loaded after them
+    void ready();
+
+private:
+    // One image of the pool, filter runs on the decoded image and variantFilter on a copy of the result
+    struct ImageJob
+    {
+        QString path;
+        ImageFilter filter;
+        ImageFilter variantFilter;
+        QImage image;
+        QImage variant;
+    };
+
+    ResourceLoader();
+    ~ResourceLoader();
+
+    // The embedded bundle, or the PNGs of the qrc on the pool
+    void loadLibrary();
+    // Fill the jobs from a bundle, storage keeps data alive; false when it is not valid
+    bool openBundle(const uchar *data, qint64 size, std::shared_ptr<void> storage);
+    void clearJobs();
+    void reload();
+    // Pool thread
+    void decode(int index);
+    // Pool thread, after the images
+    void prepare();
+    void promote();
+
+    QThreadPool m_pool;
+    // Written by the pool, every task its own job, read by promote() after the last one
+    std::vector<ImageJob> m_jobs;
+    std::atomic<int> m_remaining {0};
+    // From the start of the pool until promote(), the jobs belong to the pool
+    bool m_decoding = false;
+    // Names and frame counts of blocks.cfg, the frames follow the named images in m_jobs
+    QList<BlockResource> m_blocks;
+    // Drawn by prepare()
+    std::shared_ptr<SpriteAtlas> m_atlas;
+    // Memory the images of m_jobs wrap, handed to the next resources
+    std::shared_ptr<void> m_storage;
+    std::shared_ptr<PGlobalResources> m_resources;
+
+    QString m_pack;
+    QFileSystemWatcher m_watcher;
+    // A change of the pack comes as several events, the last one starts the reload
+    QTimer m_reloadTimer;
+};
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <array>
+
+#include <QHash>
+#include <QImage>
+#include <QList>
+#include <QPainter>
+#include <QPixmap>
+
+#include "PixelBegin.h"
+#include "PixelBitboard.h"
+
+/*
+    Every sprite of the game packed into one atlas at load time, in square slots of the largest
+    sprite. A layer is collected between begin() and draw() and drawn with one drawPixmapFragments
+    call, the opacity goes with every fragment, so the painter state does not change between sprites.
+    The atlas is scaled once per drawn size and device pixel ratio: the fragments are plain blits.
+
+    An atlas of images keeps its scaled atlases as QImage and draws them with drawImage, a pixmap may
+    not be used outside of the GUI thread. The frame composer thread draws with one of those.
+*/
+
+class PB_EXPORT SpriteAtlas
+{
+public:
+    explicit SpriteAtlas(bool images = false);
+
+    // Pack the sprites, sprite i of add() is sprites[i]. Images only: it can run on any thread
+    void setSprites(const QList<QImage> &sprites);
+    // The sprites packed by another atlas, call it on the thread of the other atlas
+    void setSprites(const SpriteAtlas &other);
+
+    // Ratio of the painted device, another ratio drops the scaled atlases
+    void setDevicePixelRatio(qreal ratio);
+    // Drop the scaled atlases, they are built again by the next draw of their size
+    void clear();
+
+    // Start a layer of sprites of size x size device independent pixels
+    void begin(int size);
+    void add(int sprite, QPoint topLeft, qreal opacity = 1.0);
+    // Draw the layer in one call and empty it
+    void draw(QPainter &painter);
+
+private:
+    // A board layer holds at most every cell
+    static constexpr int MaxFragments = BoardCells;
+
+    // The source scaled to slots of size x size device independent pixels
+    QImage scaledImage(int size) const;
+    const QPixmap &scaled(int size);
+    const QImage &scaledAsImage(int size);
+
+    bool m_images;
+    QImage m_source;
+    int m_slot = 1;
+    int m_columns = 1;
+    int m_rows = 1;
+    int m_count = 0;
+    qreal m_ratio = 1.0;
+    // drawn size -> atlas of slots of that size
+    QHash<int, QPixmap> m_scaled;
+    QHash<int, QImage> m_scaledImages;
+
+    int m_size = 0;
+    int m_pixels = 0;
+    int m_fragmentCount = 0;
+    std::array<QPainter::PixmapFragment, MaxFragments> m_fragments;
+};
@@ -0,0 +1,279 @@
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+#include "PixelSimulator.h"
+
+// First legal move, the cheapest baseline
+class FirstPolicy : public PlacementPolicy
+{
+public:
+    int choose(const GameState &/*state*/, const MoveList &/*moves*/, std::mt19937_64 &/*random*/) override
+    {
+        return 0;
+    }
+};
+
+class RandomPolicy : public PlacementPolicy
+{
+public:
+    int choose(const GameState &/*state*/, const MoveList &moves, std::mt19937_64 &random) override
+    {
+        return std::uniform_int_distribution<int>(0, moves.count - 1)(random);
+    }
+};
+
+// Best board after the move: cleared lines first, then the fewest closed holes and narrow gaps
+class GreedyPolicy : public PlacementPolicy
+{
+public:
+    int choose(const GameState &state, const MoveList &moves, std::mt19937_64 &/*random*/) override
+    {
+        int x, lines, value, best = 0, bestValue = 0;
+        Bitboard grids;
+        for(x = 0; x < moves.count; ++x)
+        {
+            grids = state.occupied | GameEngine::placementMask(rotateShape(state.candidates[moves.moves[x].candidate].shape, moves.moves[x].rotation), moves.moves[x].cell, state.width);
+            GameEngine::clearLines(grids, state.width, lines);
+            value = lines * SolverLineValue + evaluateBoard(grids, state.width);
+            if(x == 0 || value > bestValue)
+            {
+                best = x;
+                bestValue = value;
+            }
+        }
+        return best;
+    }
+};
+
+// Nodes of a SolverPolicy search, about the 2 ms of the game hints
+constexpr std::uint64_t SolverPolicyNodes = 2048;
+
+// First move of the best sequence found by GameSolver in SolverPolicyNodes nodes. The table is
+// cleared for every move: the move depends on the state only, not on the games the worker played
+// before or on the load of the machine, so a run is reproduced from --seed
+class SolverPolicy : public PlacementPolicy
+{
+public:
+    SolverPolicy()
+    {
+        solver.setNodeLimit(SolverPolicyNodes);
+    }
+
+    int choose(const GameState &state, const MoveList &moves, std::mt19937_64 &/*random*/) override
+    {
+        int x;
+        SolverResult result;
+        solver.clearTable();
+        result = solver.solve(state);
+        for(x = 0; x < moves.count && result.count > 0; ++x)
+        {
+            if(moves.moves[x].candidate == result.moves[0].candidate && moves.moves[x].cell == result.moves[0].cell && moves.moves[x].rotation == result.moves[0].rotation)
+                return x;
+        }
+        return 0;
+    }
+
+private:
+    GameSolver solver;
+};
+
+template <typename T>
+std::unique_ptr<PlacementPolicy> makePolicy()
+{
+    return std::make_unique<T>();
+}
+
+const std::vector<PolicyEntry> &placementPolicies()
+{
+    static const std::vector<PolicyEntry> entries = {
+        {"first", "first legal move", &makePolicy<FirstPolicy>, 100000},
+        {"random", "uniform random legal move", &makePolicy<RandomPolicy>, 100000},
+        {"greedy", "most lines, then fewest holes and gaps", &makePolicy<GreedyPolicy>, 100000},
+        // rarely loses a game and every move is a search: its score is the one of 200 moves
+        {"solver", "best sequence of the round found by GameSolver", &makePolicy<SolverPolicy>, 200},
+    };
+    return entries;
+}
+
+std::unique_ptr<PlacementPolicy> createPolicy(const std::string &name)
+{
+    for(const PolicyEntry &entry : placementPolicies())
+    {
+        if(name == entry.name)
+            return entry.create();
+    }
+    return nullptr;
+}
+
+void SimulationStats::add(const GameState &state, int gameMoves)
+{
+    std::size_t bucket = state.scores / state.width;
+    ++games;
+    moves += gameMoves;
+    rounds += state.round;
+    lines += bucket;
+    scoreSum += state.scores;
+    scoreSquareSum += static_cast<double>(state.scores) * state.scores;
+    minScore = minScore == -1 ? state.scores : std::min(minScore, state.scores);
+    maxScore = std::max(maxScore, state.scores);
+    maxMoves = std::max(maxMoves, gameMoves);
+    if(lineHistogram.size() <= bucket)
+        lineHistogram.resize(bucket + 1, 0);
+    ++lineHistogram[bucket];
+}
+
+void SimulationStats::merge(const SimulationStats &other)
+{
+    std::size_t x;
+    if(other.games == 0)
+        return;
+    games += other.games;
+    moves += other.moves;
+    rounds += other.rounds;
+    lines += other.lines;
+    scoreSum += other.scoreSum;
+    scoreSquareSum += other.scoreSquareSum;
+    minScore = minScore == -1 ? other.minScore : std::min(minScore, other.minScore);
+    maxScore = std::max(maxScore, other.maxScore);
+    maxMoves = std::max(maxMoves, other.maxMoves);
+    if(lineHistogram.size() < other.lineHistogram.size())
+        lineHistogram.resize(other.lineHistogram.size(), 0);
+    for(x = 0; x < other.lineHistogram.size(); ++x)
+        lineHistogram[x] += other.lineHistogram[x];
+}
+
+int SimulationStats::percentile(double part, int width) const
+{
+    std::size_t x;
+    std::uint64_t seen = 0, limit = static_cast<std::uint64_t>(std::ceil(part * games));
+    for(x = 0; x < lineHistogram.size(); ++x)
+    {
+        seen += lineHistogram[x];
+        if(seen >= limit && seen > 0)
+            return static_cast<int>(x) * width;
+    }
+    return maxScore;
+}
+
+WorkStealingPool::WorkStealingPool(int threads)
+{
+    _threads = threads > 0 ? threads : static_cast<int>(std::max(1U, std::thread::hardware_concurrency()));
+    for(int x = 0; x < _threads; ++x)
+        _queues.push_back(std::make_unique<Queue>());
+}
+
+int WorkStealingPool::threadCount() const
+{
+    return _threads;
+}
+
+bool WorkStealingPool::takeTask(int worker, std::uint64_t &task)
+{
+    int x;
+    // own queue from the back
+    {
+        Queue &own = *_queues[worker];
+        std::lock_guard<std::mutex> guard(own.lock);
+        if(!own.tasks.empty())
+        {
+            task = own.tasks.back();
+            own.tasks.pop_back();
+            return true;
+        }
+    }
+    // steal the oldest task of another worker
+    for(x = 1; x < _threads; ++x)
+    {
+        Queue &victim = *_queues[(worker + x) % _threads];
+        std::lock_guard<std::mutex> guard(victim.lock);
+        if(!victim.tasks.empty())
+        {
+            task = victim.tasks.front();
+            victim.tasks.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+void WorkStealingPool::run(std::uint64_t tasks, const std::function<void(int, std::uint64_t)> &job)
+{
+    int x;
+    std::uint64_t task;
+    std::vector<std::thread> workers;
+
+    for(task = 0; task < tasks; ++task)
+        _queues[task % _threads]->tasks.push_back(task);
+
+    workers.reserve(_threads);
+    for(x = 0; x < _threads; ++x)
+    {
+        workers.emplace_back(
+            [this, &job](int worker)
+            {
+                std::uint64_t task;
+                while(takeTask(worker, task))
+                    job(worker, task);
+            },
+            x);
+    }
+    for(std::thread &worker : workers)
+        worker.join();
+}
+
+SimulationStats runSimulation(const SimulationOptions &options, WorkStealingPool &pool)
+{
+    int x, maxMoves = options.maxMoves;
+    std::uint64_t chunks = (options.games + options.chunkSize - 1) / options.chunkSize;
+    std::vector<SimulationStats> stats(pool.threadCount());
+    std::vector<std::unique_ptr<GameEngine>> engines;
+    std::vector<std::unique_ptr<PlacementPolicy>> policies;
+    std::vector<std::mt19937_64> randoms(pool.threadCount());
+    SimulationStats total;
+
+    for(const PolicyEntry &entry : placementPolicies())
+    {
+        if(maxMoves == 0 && options.policy == entry.name)
+            maxMoves = entry.maxMoves;
+    }
+    for(x = 0; x < pool.threadCount(); ++x)
+    {
+        engines.push_back(std::make_unique<GameEngine>(options.mode, options.boardWidth));
+        engines.back()->setDifficulty(options.difficulty);
+        engines.back()->setRotation(options.rotation);
+        policies.push_back(createPolicy(options.policy));
+        if(policies.back() == nullptr)
+            return total;
+    }
+
+    pool.run(chunks,
+             [&](int worker, std::uint64_t chunk)
+             {
+                 int moves;
+                 std::uint64_t game, last = std::min<std::uint64_t>(options.games, (chunk + 1) * options.chunkSize);
+                 MoveList list;
+                 GameEngine &engine = *engines[worker];
+                 PlacementPolicy &policy = *policies[worker];
+                 std::mt19937_64 &random = randoms[worker];
+
+                 // the policy sequence of a chunk does not depend on the worker that runs it
+                 random.seed(options.seed ^ (chunk * 0x9E3779B97F4A7C15ULL));
+                 for(game = chunk * options.chunkSize; game < last; ++game)
+                 {
+                     // the game seed depends on its index only, a run is reproduced from --seed
+                     engine.setSeed(mixSeed(options.seed ^ game));
+                     engine.reset();
+                     for(moves = 0; !engine.isOver() && moves < maxMoves; ++moves)
+                     {
+                         engine.legalMoves(list);
+                         engine.applyMove(list.moves[policy.choose(engine.state(), list, random)]);
+                     }
+                     stats[worker].add(engine.state(), moves);
+                 }
+             });
+
+    for(const SimulationStats &part : stats)
+        total.merge(part);
+    return total;
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "PixelGameEngine.h"
+#include "PixelSolver.h"
+
+/*
+    Headless batch simulator: plays games with GameEngine on every core.
+    A policy picks one move from the legal moves of the current state, every worker thread
+    owns its engine, policy and random generator, so the games never share state.
+*/
+
+class PlacementPolicy
+{
+public:
+    virtual ~PlacementPolicy() = default;
+
+    // Index into moves, moves has at least one entry
+    virtual int choose(const GameState &state, const MoveList &moves, std::mt19937_64 &random) = 0;
+};
+
+struct PolicyEntry
+{
+    const char *name;
+    const char *description;
+    std::unique_ptr<PlacementPolicy> (*create)();
+    // Moves of a game when SimulationOptions::maxMoves is 0
+    int maxMoves;
+};
+
+const std::vector<PolicyEntry> &placementPolicies();
+std::unique_ptr<PlacementPolicy> createPolicy(const std::string &name);
+
+struct SimulationOptions
+{
+    std::string policy = "greedy";
+    std::uint64_t games = 10000;
+    std::uint64_t seed = 0;
+    // 0 is one thread per core
+    int threads = 0;
+    int boardWidth = DefaultBoardWidth;
+    int chunkSize = 256;
+    // A game longer than this is stopped and counted as it is, 0 is the cap of the policy
+    int maxMoves = 0;
+    CandidateMode mode = CandidateMode::Selective;
+    // Shape weights of the Selective mode, see makeCandidateWeights()
+    int difficulty = 0;
+    // Candidates may be placed in any orientation
+    bool rotation = false;
+};
+
+struct SimulationStats
+{
+    std::uint64_t games = 0;
+    std::uint64_t moves = 0;
+    std::uint64_t rounds = 0;
+    std::uint64_t lines = 0;
+    double scoreSum = 0;
+    double scoreSquareSum = 0;
+    int minScore = -1;
+    int maxScore = 0;
+    int maxMoves = 0;
+    // Games by count of cleared lines (score / width)
+    std::vector<std::uint64_t> lineHistogram;
+
+    void add(const GameState &state, int moves);
+    void merge(const SimulationStats &other);
+    // Score below which the given part of the games ends, 0.5 is the median
+    int percentile(double part, int width) const;
+};
+
+class WorkStealingPool
+{
+public:
+    explicit WorkStealingPool(int threads = 0);
+
+    int threadCount() const;
+
+    // Run job(worker, task) for every task in [0, tasks), blocks until all tasks are done
+    void run(std::uint64_t tasks, const std::function<void(int, std::uint64_t)> &job);
+
+private:
+    struct Queue
+    {
+        std::mutex lock;
+        std::deque<std::uint64_t> tasks;
+    };
+
+    bool takeTask(int worker, std::uint64_t &task);
+
+    int _threads;
+    std::vector<std::unique_ptr<Queue>> _queues;
+};
+
+SimulationStats runSimulation(const SimulationOptions &options, WorkStealingPool &pool);
@@ -0,0 +1,196 @@
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "PixelReplay.h"
+#include "PixelSimulator.h"
+
+/*
+    pixelblast_sim [options]
+        --policy NAME[,NAME...]  placement policies to compare (default greedy)
+        --games N                games per policy (default 10000)
+        --threads N              worker threads, 0 is one per core (default 0)
+        --board N                board width 8, 10, 12 or 16 (default 8)
+        --mode selective|random  candidate generator (default selective)
+        --difficulty N           -100 small shapes .. 100 large shapes in the selective mode (default 0)
+        --rotation 0|1           let the policies turn the candidates (default 0)
+        --seed N                 seed of the games and the policy generators (default 0)
+        --max-moves N            stop a game after N moves (default 200 for solver, 100000 for the others)
+        --output FILE            append JSONL records to FILE instead of stdout
+        --replay FILE[,FILE...]  fast-forward recorded games instead of simulating
+        --list                   print the policies and exit
+
+    Every policy writes one JSON line with aggregated score and game length statistics,
+    every replay one line with the final state of the game and whether all records were legal.
+*/
+
+static void printUsage()
+{
+    std::fprintf(stderr, "usage: pixelblast_sim [--policy NAME[,NAME]] [--games N] [--threads N] [--board N] [--mode selective|random] [--difficulty N] [--rotation 0|1] [--seed N] [--max-moves N] [--output FILE] [--replay FILE[,FILE]] [--list]\n");
+}
+
+static std::vector<std::string> splitNames(const char *names)
+{
+    std::vector<std::string> out;
+    std::string name;
+    for(const char *c = names;; ++c)
+    {
+        if(*c == ',' || *c == '\0')
+        {
+            if(!name.empty())
+                out.push_back(name);
+            name.clear();
+            if(*c == '\0')
+                break;
+            continue;
+        }
+        name += *c;
+    }
+    return out;
+}
+
+static void writeRecord(std::FILE *out, const SimulationOptions &options, int threads, const SimulationStats &stats, double seconds)
+{
+    double games = static_cast<double>(std::max<std::uint64_t>(1, stats.games));
+    double mean = stats.scoreSum / games;
+    double deviation = std::sqrt(std::max(0.0, stats.scoreSquareSum / games - mean * mean));
+
+    std::fprintf(out,
+                 "{\"policy\":\"%s\",\"board\":%d,\"mode\":\"%s\",\"difficulty\":%d,\"rotation\":%s,\"seed\":%llu,\"threads\":%d,\"games\":%llu,\"seconds\":%.3f,\"gamesPerSecond\":%.1f,"
+                 "\"score\":{\"mean\":%.3f,\"stddev\":%.3f,\"min\":%d,\"p50\":%d,\"p90\":%d,\"p99\":%d,\"max\":%d},"
+                 "\"moves\":{\"mean\":%.3f,\"max\":%d},\"rounds\":{\"mean\":%.3f},\"lines\":{\"mean\":%.3f}}\n",
+                 options.policy.c_str(), options.boardWidth, options.mode == CandidateMode::Selective ? "selective" : "random", options.difficulty, options.rotation ? "true" : "false", static_cast<unsigned long long>(options.seed), threads,
+                 static_cast<unsigned long long>(stats.games), seconds, seconds > 0 ? stats.games / seconds : 0.0, mean, deviation, std::max(0, stats.minScore),
+                 stats.percentile(0.5, options.boardWidth), stats.percentile(0.9, options.boardWidth), stats.percentile(0.99, options.boardWidth), stats.maxScore,
+                 stats.moves / games, stats.maxMoves, stats.rounds / games, stats.lines / games);
+    std::fflush(out);
+}
+
+static void writeReplayRecord(std::FILE *out, const std::string &path, const Replay &replay, const GameEngine &engine, int applied)
+{
+    const GameState &state = engine.state();
+    std::fprintf(out, "{\"replay\":\"%s\",\"board\":%d,\"seed\":%llu,\"records\":%d,\"applied\":%d,\"valid\":%s,\"score\":%d,\"rounds\":%d,\"over\":%s}\n", path.c_str(),
+                 replay.header.width, static_cast<unsigned long long>(replay.header.seed), static_cast<int>(replay.moves.size()), applied,
+                 applied == static_cast<int>(replay.moves.size()) ? "true" : "false", state.scores, state.round, state.over ? "true" : "false");
+}
+
+static int runReplays(const std::vector<std::string> &paths, std::FILE *out)
+{
+    int applied, failed = 0;
+    Replay replay;
+    GameEngine engine;
+    for(const std::string &path : paths)
+    {
+        if(!loadReplay(path.c_str(), replay))
+        {
+            std::fprintf(stderr, "can not read replay %s\n", path.c_str());
+            ++failed;
+            continue;
+        }
+        applied = replayMoves(engine, replay);
+        writeReplayRecord(out, path, replay, engine, applied);
+        failed += applied != static_cast<int>(replay.moves.size());
+    }
+    std::fflush(out);
+    return failed == 0 ? 0 : 2;
+}
+
+int main(int argc, char *argv[])
+{
+    int x;
+    const char *output = nullptr;
+    std::FILE *out = stdout;
+    std::vector<std::string> names = {"greedy"};
+    std::vector<std::string> replays;
+    SimulationOptions options;
+
+    for(x = 1; x < argc; ++x)
+    {
+        const char *arg = argv[x];
+        const char *value = x + 1 < argc ? argv[x + 1] : nullptr;
+        if(std::strcmp(arg, "--list") == 0)
+        {
+            for(const PolicyEntry &entry : placementPolicies())
+                std::printf("%-10s %s\n", entry.name, entry.description);
+            return 0;
+        }
+        if(value == nullptr)
+        {
+            printUsage();
+            return 1;
+        }
+        if(std::strcmp(arg, "--policy") == 0)
+            names = splitNames(value);
+        else if(std::strcmp(arg, "--games") == 0)
+            options.games = std::strtoull(value, nullptr, 10);
+        else if(std::strcmp(arg, "--threads") == 0)
+            options.threads = std::atoi(value);
+        else if(std::strcmp(arg, "--board") == 0)
+            options.boardWidth = std::atoi(value);
+        else if(std::strcmp(arg, "--mode") == 0)
+            options.mode = std::strcmp(value, "random") == 0 ? CandidateMode::Random : CandidateMode::Selective;
+        else if(std::strcmp(arg, "--difficulty") == 0)
+            options.difficulty = std::atoi(value);
+        else if(std::strcmp(arg, "--rotation") == 0)
+            options.rotation = std::atoi(value) != 0;
+        else if(std::strcmp(arg, "--seed") == 0)
+            options.seed = std::strtoull(value, nullptr, 10);
+        else if(std::strcmp(arg, "--max-moves") == 0)
+            options.maxMoves = std::atoi(value);
+        else if(std::strcmp(arg, "--output") == 0)
+            output = value;
+        else if(std::strcmp(arg, "--replay") == 0)
+            replays = splitNames(value);
+        else
+        {
+            printUsage();
+            return 1;
+        }
+        ++x;
+    }
+
+    if(options.boardWidth < MinBoardWidth || options.boardWidth > MaxBoardWidth)
+    {
+        std::fprintf(stderr, "board width must be from %d to %d\n", MinBoardWidth, MaxBoardWidth);
+        return 1;
+    }
+    for(const std::string &name : names)
+    {
+        if(createPolicy(name) == nullptr)
+        {
+            std::fprintf(stderr, "unknown policy: %s\n", name.c_str());
+            return 1;
+        }
+    }
+    if(output != nullptr && (out = std::fopen(output, "a")) == nullptr)
+    {
+        std::fprintf(stderr, "can not open %s\n", output);
+        return 1;
+    }
+
+    if(!replays.empty())
+    {
+        x = runReplays(replays, out);
+        if(out != stdout)
+            std::fclose(out);
+        return x;
+    }
+
+    WorkStealingPool pool(options.threads);
+    for(const std::string &name : names)
+    {
+        options.policy = name;
+        auto start = std::chrono::steady_clock::now();
+        SimulationStats stats = runSimulation(options, pool);
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        writeRecord(out, options, pool.threadCount(), stats, elapsed.count());
+    }
+
+    if(out != stdout)
+        std::fclose(out);
+    return 0;
+}